@@ -0,0 +1,290 @@
+#include "backup_store.hh"
+
+#include <stdexcept>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <cstdio>
+
+extern "C"
+{
+#include <sys/stat.h>
+}
+
+#define debug_info (string(__func__) + "(" + string(__FILE__) + ":" + to_string(__LINE__) + ")")
+
+string backup_file_path(const string &dbms_name, const string &db, int port)
+{
+    string path = "/tmp/" + dbms_name + "_" + db;
+    if (port > 0)
+        path += "_" + to_string(port);
+    return path + "_bk.sql";
+}
+
+// Puts stmt on one line: line breaks inside quoted literals become \n and
+// \r escapes, the ones outside (formatting of SHOW CREATE TABLE) spaces.
+static string one_line_stmt(const string &stmt)
+{
+    string line;
+    line.reserve(stmt.size());
+    char quote = 0;
+    for (size_t i = 0; i < stmt.size(); i++)
+    {
+        auto c = stmt[i];
+        if (c == '\n' || c == '\r')
+        {
+            if (quote)
+                line += c == '\n' ? "\\n" : "\\r";
+            else
+                line += ' ';
+            continue;
+        }
+        line += c;
+        if (quote)
+        {
+            if (c == '\\' && i + 1 < stmt.size() && stmt[i + 1] != '\n' && stmt[i + 1] != '\r')
+                line += stmt[++i];
+            else if (c == quote)
+                quote = 0;
+        }
+        else if (c == '\'' || c == '"' || c == '`')
+            quote = c;
+    }
+    return line;
+}
+
+static void capture_table(dut_base &dut, const string &db, const string &table, vector<string> &stmts)
+{
+    vector<vector<string>> output;
+    dut.test("SHOW CREATE TABLE " + db + "." + table + ";", &output);
+    if (output.empty() || output[0].size() < 2)
+        throw std::runtime_error("cannot get definition of " + table + "\nLocation: " + debug_info);
+    stmts.push_back(output[0][1]);
+
+    // generated columns cannot be inserted
+    dut.test("SELECT COLUMN_NAME FROM INFORMATION_SCHEMA.COLUMNS WHERE TABLE_SCHEMA='" +
+                 db + "' AND TABLE_NAME='" + table +
+                 "' AND EXTRA NOT LIKE '%GENERATED%' ORDER BY ORDINAL_POSITION;",
+             &output);
+    if (output.empty())
+        return;
+
+    string columns, quoted_columns;
+    for (auto &row : output)
+    {
+        if (!columns.empty())
+        {
+            columns += ", ";
+            quoted_columns += ", ";
+        }
+        columns += row[0];
+        quoted_columns += "QUOTE(" + row[0] + ")";
+    }
+
+    // QUOTE() gives literals that read back as the same value, and NULL for NULL
+    dut.test("SELECT " + quoted_columns + " FROM " + db + "." + table + ";", &output);
+
+    auto insert_head = "INSERT INTO " + table + " (" + columns + ") VALUES ";
+    string insert;
+    for (auto &row : output)
+    {
+        string values = "(";
+        for (size_t i = 0; i < row.size(); i++)
+        {
+            if (i > 0)
+                values += ", ";
+            values += row[i];
+        }
+        values += ")";
+
+        if (!insert.empty() && insert.size() + values.size() > BACKUP_MAX_INSERT_BYTES)
+        {
+            stmts.push_back(insert);
+            insert.clear();
+        }
+        if (insert.empty())
+            insert = insert_head;
+        else
+            insert += ", ";
+        insert += values;
+    }
+    if (!insert.empty())
+        stmts.push_back(insert);
+}
+
+// CREATE VIEW statements of the views of db, each after the views it reads
+static void capture_views(dut_base &dut, const string &db, vector<string> &stmts)
+{
+    vector<vector<string>> output;
+    dut.test("SELECT TABLE_NAME FROM INFORMATION_SCHEMA.TABLES WHERE TABLE_SCHEMA='" +
+                 db + "' AND TABLE_TYPE='VIEW' ORDER BY 1;",
+             &output);
+
+    map<string, string> create_view;
+    for (auto &row : output)
+    {
+        vector<vector<string>> definition;
+        dut.test("SHOW CREATE VIEW " + db + "." + row[0] + ";", &definition);
+        if (definition.empty() || definition[0].size() < 2)
+            throw std::runtime_error("cannot get definition of " + row[0] + "\nLocation: " + debug_info);
+        create_view[row[0]] = definition[0][1];
+    }
+
+    // SHOW CREATE VIEW quotes the views it reads with backticks
+    set<string> written;
+    while (written.size() < create_view.size())
+    {
+        auto written_num = written.size();
+        for (auto &[view, stmt] : create_view)
+        {
+            if (written.count(view))
+                continue;
+            bool ready = true;
+            for (auto &[other, other_stmt] : create_view)
+            {
+                if (other != view && !written.count(other) &&
+                    stmt.find("`" + other + "`") != string::npos)
+                    ready = false;
+            }
+            if (!ready)
+                continue;
+            stmts.push_back(stmt);
+            written.insert(view);
+        }
+        if (written.size() == written_num)
+            throw std::runtime_error("cyclic view definitions in " + db + "\nLocation: " + debug_info);
+    }
+}
+
+void backup_capture(dut_base &dut, const string &db, const string &path)
+{
+    vector<vector<string>> output;
+    dut.test("SELECT TABLE_NAME FROM INFORMATION_SCHEMA.TABLES WHERE TABLE_SCHEMA='" +
+                 db + "' AND TABLE_TYPE='BASE TABLE' ORDER BY 1;",
+             &output);
+
+    vector<string> stmts;
+    for (auto &row : output)
+        capture_table(dut, db, row[0], stmts);
+    // the views read the tables, so they are replayed after them
+    capture_views(dut, db, stmts);
+
+    // written aside and renamed, so that a reader never sees half a backup
+    auto tmp_path = path + ".tmp";
+    ofstream out(tmp_path);
+    out << BACKUP_FILE_HEADER << endl;
+    for (auto &stmt : stmts)
+        out << one_line_stmt(stmt) << ";" << endl;
+    out.close();
+    if (!out || rename(tmp_path.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("cannot write backup " + path + "\nLocation: " + debug_info);
+}
+
+struct loaded_backup
+{
+    struct timespec mtime;
+    off_t size;
+    ino_t ino;
+    shared_ptr<const vector<string>> stmts;
+};
+
+shared_ptr<const vector<string>> backup_load(const string &path)
+{
+    static map<string, loaded_backup> loaded;
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return NULL;
+
+    auto iter = loaded.find(path);
+    if (iter != loaded.end())
+    {
+        auto &b = iter->second;
+        if (b.ino == st.st_ino && b.size == st.st_size &&
+            b.mtime.tv_sec == st.st_mtim.tv_sec && b.mtime.tv_nsec == st.st_mtim.tv_nsec)
+            return b.stmts;
+        loaded.erase(iter);
+    }
+
+    ifstream in(path);
+    string line;
+    if (!getline(in, line) || line != BACKUP_FILE_HEADER)
+        return NULL;
+
+    auto stmts = make_shared<vector<string>>();
+    while (getline(in, line))
+    {
+        if (line.empty())
+            continue;
+        if (line.back() == ';')
+            line.pop_back();
+        stmts->push_back(line);
+    }
+
+    loaded_backup b;
+    b.mtime = st.st_mtim;
+    b.size = st.st_size;
+    b.ino = st.st_ino;
+    b.stmts = stmts;
+    loaded[path] = b;
+    return stmts;
+}
+
+static string snapshot_db(const string &db)
+{
+    return db + "_snapshot";
+}
+
+// base tables of db, sorted by name
+static void snapshot_tables(dut_base &dut, const string &db, vector<string> &tables)
+{
+    vector<vector<string>> output;
+    dut.test("SELECT TABLE_NAME FROM INFORMATION_SCHEMA.TABLES WHERE TABLE_SCHEMA='" +
+                 db + "' AND TABLE_TYPE='BASE TABLE' ORDER BY 1;",
+             &output);
+    tables.clear();
+    for (auto &row : output)
+        tables.push_back(row[0]);
+}
+
+void snapshot_save(dut_base &dut, const string &db)
+{
+    vector<string> tables;
+    snapshot_tables(dut, db, tables);
+
+    auto snap_db = snapshot_db(db);
+    dut.test("DROP DATABASE IF EXISTS " + snap_db + ";");
+    dut.test("CREATE DATABASE " + snap_db + ";");
+    for (auto &table : tables)
+    {
+        dut.test("CREATE TABLE " + snap_db + "." + table + " LIKE " + db + "." + table + ";");
+        dut.test("INSERT INTO " + snap_db + "." + table + " SELECT * FROM " + db + "." + table + ";");
+    }
+}
+
+bool snapshot_restore(dut_base &dut, const string &db, const string &clear_stmt)
+{
+    try
+    {
+        vector<string> snap_tables, tables;
+        auto snap_db = snapshot_db(db);
+        snapshot_tables(dut, snap_db, snap_tables);
+        snapshot_tables(dut, db, tables);
+        // tables created or dropped since the snapshot cannot be copied back
+        if (snap_tables.empty() || snap_tables != tables)
+            return false;
+
+        for (auto &table : tables)
+        {
+            dut.test(clear_stmt + " " + db + "." + table + ";");
+            dut.test("INSERT INTO " + db + "." + table + " SELECT * FROM " + snap_db + "." + table + ";");
+        }
+    }
+    catch (exception &e)
+    {
+        cerr << "cannot restore snapshot: " << e.what() << endl;
+        return false;
+    }
+    return true;
+}
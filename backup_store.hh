@@ -0,0 +1,54 @@
+/// @file
+/// @brief Per-instance backup of the test database
+
+#ifndef BACKUP_STORE_HH
+#define BACKUP_STORE_HH
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "dut.hh"
+
+using namespace std;
+
+// first line of a backup written by backup_capture()
+#define BACKUP_FILE_HEADER "-- transfuzz backup v1"
+
+// name of the backup in the directory of a found bug
+#define BACKUP_REPORT_FILE "mysql_bk.sql"
+
+// largest multi-row INSERT written into a backup
+#define BACKUP_MAX_INSERT_BYTES (1 << 20)
+
+/**
+ * The backup of db on one server instance lives in its own file, so several
+ * fuzzers on one host do not clobber each other.
+ */
+string backup_file_path(const string &dbms_name, const string &db, int port);
+
+/**
+ * Dumps the tables of db through dut into path: the CREATE TABLE statements,
+ * the rows as multi-row INSERTs, then the CREATE VIEW statements. The file is a valid sql script with one
+ * statement per line, so it can also be replayed with the mysql client.
+ */
+void backup_capture(dut_base &dut, const string &db, const string &path);
+
+/**
+ * Statements replaying the backup in path. The file is parsed once per
+ * process and cached until it changes. Returns NULL if path does not exist
+ * or was not written by backup_capture() (e.g. a mysqldump file).
+ */
+shared_ptr<const vector<string>> backup_load(const string &path);
+
+/**
+ * In-server snapshot of the base tables of db, in the database db_snapshot,
+ * taken and restored through dut. clear_stmt empties a table before its rows
+ * are copied back ("TRUNCATE TABLE", or "DELETE FROM" where truncating is
+ * slow). snapshot_restore() returns false if the tables changed since the
+ * snapshot or cannot be copied back.
+ */
+void snapshot_save(dut_base &dut, const string &db);
+bool snapshot_restore(dut_base &dut, const string &db, const string &clear_stmt);
+
+#endif
@@ -0,0 +1,138 @@
+#include "client_stmt.hh"
+
+#include <stdexcept>
+#include <cstring>
+#include <type_traits>
+#include <memory>
+
+#define debug_info (string(__func__) + "(" + string(__FILE__) + ":" + to_string(__LINE__) + ")")
+
+bool binary_result_is_exact(MYSQL_STMT *st)
+{
+    auto meta = mysql_stmt_result_metadata(st);
+    if (meta == NULL)
+        return true; // no result set
+
+    bool is_exact = true;
+    auto fields = mysql_fetch_fields(meta);
+    auto column_num = mysql_num_fields(meta);
+    for (unsigned int i = 0; i < column_num && is_exact; i++)
+    {
+        if (fields[i].flags & ZEROFILL_FLAG)
+            is_exact = false;
+        switch (fields[i].type)
+        {
+        case MYSQL_TYPE_TINY:
+        case MYSQL_TYPE_SHORT:
+        case MYSQL_TYPE_INT24:
+        case MYSQL_TYPE_LONG:
+        case MYSQL_TYPE_LONGLONG:
+        case MYSQL_TYPE_DECIMAL:
+        case MYSQL_TYPE_NEWDECIMAL:
+        case MYSQL_TYPE_VARCHAR:
+        case MYSQL_TYPE_VAR_STRING:
+        case MYSQL_TYPE_STRING:
+        case MYSQL_TYPE_TINY_BLOB:
+        case MYSQL_TYPE_MEDIUM_BLOB:
+        case MYSQL_TYPE_LONG_BLOB:
+        case MYSQL_TYPE_BLOB:
+            break;
+        default:
+            is_exact = false;
+        }
+    }
+    mysql_free_result(meta);
+    return is_exact;
+}
+
+void fetch_stmt_result(MYSQL_STMT *st, vector<vector<string>> *output)
+{
+    auto column_num = mysql_stmt_field_count(st);
+    if (output == NULL || column_num == 0)
+        return;
+
+    // bind no buffer first to learn the length of each column
+    vector<MYSQL_BIND> binds(column_num);
+    vector<unsigned long> lengths(column_num);
+    // my_bool or bool, depending on the client library (not vector<bool>)
+    typedef remove_pointer<decltype(MYSQL_BIND::is_null)>::type null_flag;
+    unique_ptr<null_flag[]> is_null(new null_flag[column_num]());
+    memset(binds.data(), 0, sizeof(MYSQL_BIND) * column_num);
+    for (unsigned int i = 0; i < column_num; i++)
+    {
+        binds[i].buffer_type = MYSQL_TYPE_STRING;
+        binds[i].length = &lengths[i];
+        binds[i].is_null = &is_null[i];
+    }
+    if (mysql_stmt_bind_result(st, binds.data()))
+        throw std::runtime_error("mysql_stmt_bind_result fails: " + string(mysql_stmt_error(st)) + "\nLocation: " + debug_info);
+
+    while (true)
+    {
+        auto ret = mysql_stmt_fetch(st);
+        if (ret == MYSQL_NO_DATA)
+            break;
+        if (ret == 1)
+            throw std::runtime_error("mysql_stmt_fetch fails: " + string(mysql_stmt_error(st)) + "\nLocation: " + debug_info);
+
+        vector<string> row_output;
+        for (unsigned int i = 0; i < column_num; i++)
+        {
+            if (is_null[i])
+            {
+                row_output.push_back("NULL");
+                continue;
+            }
+
+            string str(lengths[i] + 1, '\0');
+            MYSQL_BIND column_bind;
+            memset(&column_bind, 0, sizeof(column_bind));
+            column_bind.buffer_type = MYSQL_TYPE_STRING;
+            column_bind.buffer = &str[0];
+            column_bind.buffer_length = str.size();
+            if (mysql_stmt_fetch_column(st, &column_bind, i, 0))
+                throw std::runtime_error("mysql_stmt_fetch_column fails: " + string(mysql_stmt_error(st)) + "\nLocation: " + debug_info);
+            str.resize(lengths[i]);
+            row_output.push_back(str);
+        }
+        output->push_back(row_output);
+    }
+}
+
+bool bind_stmt_params(MYSQL_STMT *st, vector<stmt_param> &params, vector<MYSQL_BIND> &binds)
+{
+    if (mysql_stmt_param_count(st) != params.size())
+        return false;
+    if (params.empty())
+        return true;
+
+    binds.resize(params.size());
+    memset(binds.data(), 0, sizeof(MYSQL_BIND) * binds.size());
+    for (size_t i = 0; i < params.size(); i++)
+    {
+        auto &param = params[i];
+        auto &bind = binds[i];
+        switch (param.kind)
+        {
+        case stmt_param::PARAM_INTEGER:
+            bind.buffer_type = MYSQL_TYPE_LONGLONG;
+            bind.buffer = &param.int_value;
+            break;
+        case stmt_param::PARAM_REAL:
+            bind.buffer_type = MYSQL_TYPE_DOUBLE;
+            bind.buffer = &param.real_value;
+            break;
+        case stmt_param::PARAM_DECIMAL:
+            bind.buffer_type = MYSQL_TYPE_NEWDECIMAL;
+            bind.buffer = &param.text[0];
+            bind.buffer_length = param.text.size();
+            break;
+        case stmt_param::PARAM_TEXT:
+            bind.buffer_type = MYSQL_TYPE_STRING;
+            bind.buffer = &param.text[0];
+            bind.buffer_length = param.text.size();
+            break;
+        }
+    }
+    return mysql_stmt_bind_param(st, binds.data()) == 0;
+}
@@ -0,0 +1,35 @@
+/// @file
+/// @brief Server-side prepared statements of the libmysqlclient duts
+
+#ifndef CLIENT_STMT_HH
+#define CLIENT_STMT_HH
+
+extern "C"
+{
+#include <mysql/mysql.h>
+}
+
+#include <string>
+#include <vector>
+
+#include "stmt_shape.hh"
+
+using namespace std;
+
+/**
+ * True if the client prints every result column of st exactly as the
+ * server does in the text protocol, so that outputs do not depend on the
+ * protocol (floats and temporal types are formatted by the client).
+ */
+bool binary_result_is_exact(MYSQL_STMT *st);
+
+// Fetches the stored result of st as strings, like the text protocol.
+void fetch_stmt_result(MYSQL_STMT *st, vector<vector<string>> *output);
+
+/**
+ * Binds params to the "?" of st. The binds point into params, so both must
+ * live until st is executed. False if they do not match the placeholders.
+ */
+bool bind_stmt_params(MYSQL_STMT *st, vector<stmt_param> &params, vector<MYSQL_BIND> &binds);
+
+#endif
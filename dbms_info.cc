@@ -1,4 +1,5 @@
 #include "dbms_info.hh"
+#include <algorithm>
 
 dbms_info::dbms_info(map<string, string> &options)
 {
@@ -84,5 +85,67 @@ dbms_info::dbms_info(map<string, string> &options)
     else
         ouput_or_affect_num = 0;
 
+    prepared_instrumentation = options.count("prepared-instrumentation") > 0;
+    // mysql has no non-blocking prepared statement API, it would silently
+    // keep the text protocol
+    if (prepared_instrumentation && dbms_name != "mariadb" && dbms_name != "tidb")
+    {
+        cerr << "--prepared-instrumentation only supports mariadb and tidb" << endl;
+        throw runtime_error("Unsupported prepared instrumentation");
+    }
+    batched_instrumentation = options.count("batched-instrumentation") > 0;
+    snapshot_restore = options.count("snapshot-restore") > 0;
+    datadir_restore = options.count("datadir-restore") > 0;
+    content_fingerprint = options.count("content-fingerprint") > 0;
+    server_profile = "default";
+    if (options.count("server-profile"))
+        server_profile = options["server-profile"];
+    if (server_profile != "default" && server_profile != "fuzz")
+        throw runtime_error("Unknown server profile " + server_profile);
+    if (server_profile != "default" && dbms_name != "mysql" && dbms_name != "mariadb")
+    {
+        cerr << "the " << server_profile << " server profile only applies to the servers forked for mysql and mariadb" << endl;
+        throw runtime_error("Unsupported server profile");
+    }
+
+    concurrent_txn_num = DEFAULT_CONCURRENT_TXN_NUM;
+    if (options.count("concurrent-txns"))
+        concurrent_txn_num = stoi(options["concurrent-txns"]);
+    txn_num = concurrent_txn_num * 2;
+    if (options.count("txns"))
+        txn_num = stoi(options["txns"]);
+    txn_stmt_num = DEFAULT_TXN_STMT_NUM;
+    if (options.count("txn-stmts"))
+        txn_stmt_num = stoi(options["txn-stmts"]);
+    tests_per_db = TEST_TIME_FOR_EACH_DB;
+    if (options.count("tests-per-db"))
+        tests_per_db = stoi(options["tests-per-db"]);
+    if (txn_num < 1 || concurrent_txn_num < 1 || tests_per_db < 1)
+        throw runtime_error("--txns, --concurrent-txns and --tests-per-db must be positive");
+    if (txn_stmt_num < 3) // begin, one statement, commit/abort
+        throw runtime_error("--txn-stmts must be at least 3");
+
+    worker_id = -1;
+    server_id = -1;
+
     return;
+}
+
+void dbms_info::use_managed_server(int id)
+{
+    test_port += id - max(server_id, 0);
+    server_id = id;
+}
+
+string managed_server_dir(const string &dbms_name, int server_id, const string &profile)
+{
+    string base = profile == "fuzz" ? "/dev/shm" : "/tmp";
+    return base + "/transfuzz_" + dbms_name + "_server_" + to_string(server_id);
+}
+
+string managed_server_socket(dbms_info &d_info)
+{
+    if (d_info.server_id < 0)
+        return "";
+    return managed_server_dir(d_info.dbms_name, d_info.server_id, d_info.server_profile) + "/mysqld.sock";
 }
\ No newline at end of file
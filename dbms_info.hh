@@ -8,6 +8,13 @@
 
 using namespace std;
 
+// default shape of the generated histories
+#define DEFAULT_CONCURRENT_TXN_NUM 3
+#define DEFAULT_TXN_NUM (DEFAULT_CONCURRENT_TXN_NUM * 2)
+#define DEFAULT_TXN_STMT_NUM 4
+// tests run on each generated database
+#define TEST_TIME_FOR_EACH_DB 10
+
 /**
  * Configuration of a DBMS.
  */
@@ -18,8 +25,37 @@ struct dbms_info
     int test_port;
     int ouput_or_affect_num;
     bool can_trigger_error_in_txn;
+    // run instrumentation reads as server-side prepared statements
+    bool prepared_instrumentation;
+    // send the statements a txn runs back to back as one multi-statement batch
+    bool batched_instrumentation;
+    // restore the backup from a copy of the tables kept in the server
+    bool snapshot_restore;
+    // restore the backup by restarting the server on a copy of its datadir
+    bool datadir_restore;
+    // compare the database contents by server-side checksums, and fetch the
+    // rows only when they are needed
+    bool content_fingerprint;
+    // settings of the servers forked by fork_db_server(): "default", or
+    // "fuzz" for a datadir on tmpfs and no durability, see --server-profile
+    string server_profile;
+    // shape of the generated histories: transactions per test, how many of
+    // them interleave at a time, and statements per transaction including
+    // the begin and the commit/abort
+    int txn_num;
+    int concurrent_txn_num;
+    int txn_stmt_num;
+    // tests run on each generated database
+    int tests_per_db;
+    // index of the fuzzing loop using this database, -1 without --workers
+    int worker_id;
+    // managed server instance the database lives on, -1 without --servers
+    int server_id;
 
     dbms_info(map<string, string> &options);
+    // moves to the managed instance id, listening on the port of the
+    // options plus id
+    void use_managed_server(int id);
     dbms_info()
     {
         dbms_name = "";
@@ -27,6 +63,18 @@ struct dbms_info
         test_port = 0;
         ouput_or_affect_num = 0;
         can_trigger_error_in_txn = false;
+        prepared_instrumentation = false;
+        batched_instrumentation = false;
+        snapshot_restore = false;
+        datadir_restore = false;
+        content_fingerprint = false;
+        server_profile = "default";
+        txn_num = DEFAULT_TXN_NUM;
+        concurrent_txn_num = DEFAULT_CONCURRENT_TXN_NUM;
+        txn_stmt_num = DEFAULT_TXN_STMT_NUM;
+        tests_per_db = TEST_TIME_FOR_EACH_DB;
+        worker_id = -1;
+        server_id = -1;
     };
     void operator=(dbms_info &target)
     {
@@ -35,7 +83,28 @@ struct dbms_info
         test_port = target.test_port;
         ouput_or_affect_num = target.ouput_or_affect_num;
         can_trigger_error_in_txn = target.can_trigger_error_in_txn;
+        prepared_instrumentation = target.prepared_instrumentation;
+        batched_instrumentation = target.batched_instrumentation;
+        snapshot_restore = target.snapshot_restore;
+        datadir_restore = target.datadir_restore;
+        content_fingerprint = target.content_fingerprint;
+        server_profile = target.server_profile;
+        txn_num = target.txn_num;
+        concurrent_txn_num = target.concurrent_txn_num;
+        txn_stmt_num = target.txn_stmt_num;
+        tests_per_db = target.tests_per_db;
+        worker_id = target.worker_id;
+        server_id = target.server_id;
     }
 };
 
+/**
+ * Directory of the managed server instance server_id of dbms_name, holding
+ * its datadir, socket, pid file and error log. It is on tmpfs with the fuzz
+ * server profile.
+ */
+string managed_server_dir(const string &dbms_name, int server_id, const string &profile);
+// socket of the managed instance of d_info, empty without --servers
+string managed_server_socket(dbms_info &d_info);
+
 #endif
\ No newline at end of file
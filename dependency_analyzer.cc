@@ -1,6 +1,9 @@
 #include <dependency_analyzer.hh>
 #include <functional>
 #include <time.h>
+#include <chrono>
+#include <iomanip>
+#include <random>
 
 #define RESET "\033[0m"
 #define BLACK "\033[30m"            /* Black */
@@ -15,35 +18,38 @@
 
 using std::function;
 
+void history::reserve()
+{
+    change_history.reserve(row_op_num.size());
+    row_idx.reserve(row_op_num.size());
+}
+
 void history::insert_to_history(operate_unit &oper_unit)
 {
     auto row_id = oper_unit.row_id;
-    auto size = change_history.size();
-    bool exist_row_id = false;
-    int row_idx;
-    for (int i = 0; i < size; i++)
-    {
-        if (change_history[i].row_id == row_id)
-        {
-            exist_row_id = true;
-            row_idx = i;
-            break;
-        }
-    }
-
-    if (exist_row_id)
-        change_history[row_idx].row_op_list.push_back(oper_unit);
-    else
+    auto [iter, new_row] = row_idx.try_emplace(row_id, change_history.size());
+    if (new_row)
     {
-        row_change_history rch;
+        change_history.emplace_back();
+        auto &rch = change_history.back();
         rch.row_id = row_id;
-        rch.row_op_list.push_back(oper_unit);
-        change_history.push_back(rch);
+        auto op_num = row_op_num.find(row_id);
+        if (op_num != row_op_num.end())
+            rch.row_op_list.reserve(op_num->second);
     }
+    change_history[iter->second].row_op_list.push_back(oper_unit);
 
     return;
 }
 
+row_change_history *history::find_row(int row_id)
+{
+    auto iter = row_idx.find(row_id);
+    if (iter == row_idx.end())
+        return NULL;
+    return &change_history[iter->second];
+}
+
 stmt_id::stmt_id(vector<int> &final_tid_queue, int stmt_idx)
 {
     txn_id = final_tid_queue[stmt_idx];
@@ -73,10 +79,21 @@ int stmt_id::transfer_2_stmt_idx(vector<int> &final_tid_queue)
     return -1;
 }
 
+// same as transfer_2_stmt_idx(f_txn_id_queue)
+int dependency_analyzer::to_stmt_idx(const stmt_id &id)
+{
+    if (id.txn_id < 0 || id.txn_id >= tid_num || id.stmt_idx_in_txn < 0)
+        return -1;
+    auto &stmt_pos = f_txn_stmt_pos[id.txn_id];
+    if (id.stmt_idx_in_txn >= stmt_pos.size())
+        return -1;
+    return stmt_pos[id.stmt_idx_in_txn];
+}
+
 void dependency_analyzer::build_stmt_depend_from_stmt_idx(int stmt_idx1, int stmt_idx2, dependency_type dt)
 {
-    auto stmt_id1 = stmt_id(f_txn_id_queue, stmt_idx1);
-    auto stmt_id2 = stmt_id(f_txn_id_queue, stmt_idx2);
+    auto stmt_id1 = to_stmt_id(stmt_idx1);
+    auto stmt_id2 = to_stmt_id(stmt_idx2);
     auto stmt_pair = make_pair(stmt_id1, stmt_id2);
     if (stmt_dependency_graph.count(stmt_pair) > 0)
         stmt_dependency_graph[stmt_pair].insert(dt);
@@ -88,7 +105,7 @@ void dependency_analyzer::build_stmt_depend_from_stmt_idx(int stmt_idx1, int stm
     }
 }
 
-size_t dependency_analyzer::hash_output(row_output &row)
+size_t hash_output(const row_output &row)
 {
     size_t hash = 0;
     for (auto &str : row)
@@ -103,6 +120,46 @@ size_t dependency_analyzer::hash_output(row_output &row)
     return hash;
 }
 
+recorded_outputs::recorded_outputs(int primary_key_idx, int write_op_key_idx) : primary_key_index(primary_key_idx),
+                                                                                version_key_index(write_op_key_idx),
+                                                                                row_begin(1, 0)
+{
+}
+
+void recorded_outputs::append(stmt_output &&output)
+{
+    for (auto &row : output)
+    {
+        pk.push_back(stoi(row[primary_key_index]));
+        version.push_back(stoi(row[version_key_index]));
+        hash.push_back(hash_output(row));
+        rows.push_back(move(row));
+    }
+    row_begin.push_back(rows.size());
+}
+
+string dependency_analyzer::op_row(const operate_unit &op)
+{
+    auto &outputs = op.stmt_idx < 0 ? *f_init_outputs : *f_outputs;
+    int begin = 0;
+    int end = outputs.rows.size();
+    if (op.stmt_idx >= 0)
+    {
+        begin = outputs.row_begin[op.stmt_idx];
+        end = outputs.row_begin[op.stmt_idx + 1];
+    }
+    for (int r = begin; r < end; r++)
+    {
+        if (outputs.hash[r] != op.hash || outputs.pk[r] != op.row_id)
+            continue;
+        string row_str;
+        for (auto &str : outputs.rows[r])
+            row_str += str + " ";
+        return row_str;
+    }
+    return "(unknown row) row " + to_string(op.row_id) + ", version " + to_string(op.write_op_id);
+}
+
 // for BEFORE_WRITE_READ, VERSION_SET_READ, SELECT_READ
 void dependency_analyzer::build_directly_read_dependency(vector<operate_unit> &op_list, int op_idx)
 {
@@ -134,21 +191,13 @@ void dependency_analyzer::build_directly_read_dependency(vector<operate_unit> &o
         cerr << "Read stmt idx: " << target_op.stmt_idx << endl;
         cerr << "Read stmt tid: " << target_op.tid << endl;
 
-        cerr << "Problem read: ";
-        auto &problem_row = hash_to_output[target_op.hash];
-        for (int i = 0; i < problem_row.size(); i++)
-            cerr << problem_row[i] << " ";
-        cerr << endl;
+        cerr << "Problem read: " << op_row(target_op) << endl;
 
         for (int i = 0; i < op_list.size(); i++)
         {
             if (op_list[i].stmt_u != AFTER_WRITE_READ)
                 continue;
-            cerr << "AFTER_WRITE_READ " << i << ": ";
-            auto &write_row = hash_to_output[op_list[i].hash];
-            for (int i = 0; i < write_row.size(); i++)
-                cerr << write_row[i] << " ";
-            cerr << endl;
+            cerr << "AFTER_WRITE_READ " << i << ": " << op_row(op_list[i]) << endl;
         }
 
         throw runtime_error("BUG: Cannot find the corresponding write");
@@ -234,14 +283,12 @@ void dependency_analyzer::build_VS_dependency()
         if (i_stmt_u != VERSION_SET_READ)
             continue;
         auto &i_tid = f_txn_id_queue[i];
-        auto &i_output = f_stmt_output[i];
-
         set<pair<int, int>> i_pv_pair_set; // primary_key, version_key
         set<int> i_primary_set;            // primary_key
-        for (auto &row : i_output)
+        for (int r = f_outputs->row_begin[i]; r < f_outputs->row_begin[i + 1]; r++)
         {
-            auto row_id = stoi(row[primary_key_index]);
-            auto version_id = stoi(row[version_key_index]);
+            auto row_id = f_outputs->pk[r];
+            auto version_id = f_outputs->version[r];
             pair<int, int> p(row_id, version_id);
             i_pv_pair_set.insert(p);
             i_primary_set.insert(row_id);
@@ -268,13 +315,10 @@ void dependency_analyzer::build_VS_dependency()
                     cerr << err_info << endl;
                     throw runtime_error(err_info);
                 }
-                auto &after_write_output = f_stmt_output[after_write_idx];
                 set<pair<int, int>> after_write_pv_pair_set; // primary_key, version_key
-                for (auto &row : after_write_output)
+                for (int r = f_outputs->row_begin[after_write_idx]; r < f_outputs->row_begin[after_write_idx + 1]; r++)
                 {
-                    auto row_id = stoi(row[primary_key_index]);
-                    auto version_id = stoi(row[version_key_index]);
-                    pair<int, int> p(row_id, version_id);
+                    pair<int, int> p(f_outputs->pk[r], f_outputs->version[r]);
                     after_write_pv_pair_set.insert(p);
                 }
 
@@ -315,16 +359,12 @@ void dependency_analyzer::build_VS_dependency()
                 if (f_stmt_usage[before_write_idx].target_table != i_stmt_u.target_table)
                     continue;
 
-                auto &before_write_output = f_stmt_output[before_write_idx];
-                if (before_write_output.empty()) // delete nothing, skip
+                if (f_outputs->row_begin[before_write_idx] == f_outputs->row_begin[before_write_idx + 1]) // delete nothing, skip
                     continue;
 
                 set<int> before_write_primary_set; // primary_key, version_key
-                for (auto &row : before_write_output)
-                {
-                    auto row_id = stoi(row[primary_key_index]);
-                    before_write_primary_set.insert(row_id);
-                }
+                for (int r = f_outputs->row_begin[before_write_idx]; r < f_outputs->row_begin[before_write_idx + 1]; r++)
+                    before_write_primary_set.insert(f_outputs->pk[r]);
 
                 set<int> res;
                 set_intersection(i_primary_set.begin(), i_primary_set.begin(),
@@ -346,11 +386,10 @@ void dependency_analyzer::read_stmt_output_into_pk_and_version(int stmt_idx, set
 {
     assert(stmt_idx >= 0 && stmt_idx < stmt_num);
 
-    auto &stmt_output = f_stmt_output[stmt_idx];
-    for (auto &row : stmt_output)
+    for (int r = f_outputs->row_begin[stmt_idx]; r < f_outputs->row_begin[stmt_idx + 1]; r++)
     {
-        auto row_id = stoi(row[primary_key_index]);
-        auto version_id = stoi(row[version_key_index]);
+        auto row_id = f_outputs->pk[r];
+        auto version_id = f_outputs->version[r];
 
         assert(pk_version_pair.count({row_id, version_id}) == 0);
         pk_version_pair.insert({row_id, version_id});
@@ -366,11 +405,9 @@ bool dependency_analyzer::check_which_version_is_higher(int row_id, int v1, int
     // We can look in the history.
 
     // Maybe we can just look at the history.
-    for (auto &change_history : h.change_history)
+    if (auto row_history = h.find_row(row_id))
     {
-        if (change_history.row_id != row_id)
-            continue;
-
+        auto &change_history = *row_history;
         int v1_idx = -1, v2_idx = -1;
         for (int i = 0; i < change_history.row_op_list.size(); i++)
         {
@@ -572,14 +609,12 @@ void dependency_analyzer::build_OW_dependency()
         if (i_stmt_u != VERSION_SET_READ)
             continue;
         auto &i_tid = f_txn_id_queue[i];
-        auto &i_output = f_stmt_output[i];
-
         set<pair<int, int>> i_pv_pair_set; // primary_key, version_key
         set<int> i_primary_set;            // primary_key
-        for (auto &row : i_output)
+        for (int r = f_outputs->row_begin[i]; r < f_outputs->row_begin[i + 1]; r++)
         {
-            auto row_id = stoi(row[primary_key_index]);
-            auto version_id = stoi(row[version_key_index]);
+            auto row_id = f_outputs->pk[r];
+            auto version_id = f_outputs->version[r];
             pair<int, int> p(row_id, version_id);
             i_pv_pair_set.insert(p);
             i_primary_set.insert(row_id);
@@ -640,13 +675,10 @@ void dependency_analyzer::build_OW_dependency()
                     cerr << err_info << endl;
                     throw runtime_error(err_info);
                 }
-                auto &before_write_output = f_stmt_output[before_write_idx];
                 set<pair<int, int>> before_write_pv_pair_set; // primary_key, version_key
-                for (auto &row : before_write_output)
+                for (int r = f_outputs->row_begin[before_write_idx]; r < f_outputs->row_begin[before_write_idx + 1]; r++)
                 {
-                    auto row_id = stoi(row[primary_key_index]);
-                    auto version_id = stoi(row[version_key_index]);
-                    pair<int, int> p(row_id, version_id);
+                    pair<int, int> p(f_outputs->pk[r], f_outputs->version[r]);
                     before_write_pv_pair_set.insert(p);
                 }
 
@@ -681,15 +713,11 @@ void dependency_analyzer::build_OW_dependency()
                 if (f_stmt_usage[after_write_idx].target_table != i_stmt_u.target_table)
                     continue;
 
-                auto &after_write_output = f_stmt_output[after_write_idx];
-                if (after_write_output.empty()) // insert nothing, skip
+                if (f_outputs->row_begin[after_write_idx] == f_outputs->row_begin[after_write_idx + 1]) // insert nothing, skip
                     continue;
                 set<int> after_write_primary_set;
-                for (auto &row : after_write_output)
-                {
-                    auto row_id = stoi(row[primary_key_index]);
-                    after_write_primary_set.insert(row_id);
-                }
+                for (int r = f_outputs->row_begin[after_write_idx]; r < f_outputs->row_begin[after_write_idx + 1]; r++)
+                    after_write_primary_set.insert(f_outputs->pk[r]);
                 set<int> res;
                 set_intersection(i_primary_set.begin(), i_primary_set.begin(),
                                  after_write_primary_set.begin(), after_write_primary_set.begin(),
@@ -902,12 +930,12 @@ set<int> dependency_analyzer::get_instrumented_stmt_set(int queue_idx)
         init_idx_set.erase(select_idx);
         processed_idx_set.insert(select_idx);
 
-        auto stmt_id1 = stmt_id(f_txn_id_queue, select_idx);
+        auto stmt_id1 = to_stmt_id(select_idx);
         for (int i = 0; i < stmt_num; i++)
         {
             if (processed_idx_set.count(i) > 0) // has been processed
                 continue;
-            auto stmt_id2 = stmt_id(f_txn_id_queue, i);
+            auto stmt_id2 = to_stmt_id(i);
             pair<stmt_id, stmt_id> instrument_pair;
             if (i < select_idx)
                 instrument_pair = make_pair<>(stmt_id2, stmt_id1);
@@ -1148,85 +1176,76 @@ bool dependency_analyzer::check_any_transaction_cycle(bool ignore_overwrites)
     return false;
 }
 
-dependency_analyzer::dependency_analyzer(vector<stmt_output> &init_output,
-                                         vector<stmt_output> &total_output,
+dependency_analyzer::dependency_analyzer(shared_ptr<const recorded_outputs> init_output,
+                                         shared_ptr<const recorded_outputs> total_output,
                                          vector<int> &final_tid_queue,
                                          vector<stmt_usage> &final_stmt_usage,
                                          vector<txn_status> &final_txn_status,
-                                         int t_num,
-                                         int primary_key_idx,
-                                         int write_op_key_idx) : tid_num(t_num + 1), // add 1 for init txn
-                                                                 tid_begin_idx(NULL),
-                                                                 tid_strict_begin_idx(NULL),
-                                                                 tid_end_idx(NULL),
-                                                                 primary_key_index(primary_key_idx),
-                                                                 version_key_index(write_op_key_idx),
-                                                                 f_txn_status(final_txn_status),
-                                                                 f_txn_id_queue(final_tid_queue),
-                                                                 f_stmt_usage(final_stmt_usage),
-                                                                 f_stmt_output(total_output)
+                                         int t_num) : tid_num(t_num + 1), // add 1 for init txn
+                                                      tid_begin_idx(NULL),
+                                                      tid_strict_begin_idx(NULL),
+                                                      tid_end_idx(NULL),
+                                                      f_txn_status(final_txn_status),
+                                                      f_txn_id_queue(final_tid_queue),
+                                                      f_stmt_usage(final_stmt_usage),
+                                                      f_init_outputs(init_output),
+                                                      f_outputs(total_output)
 {
-    if (f_stmt_output.size() != f_txn_id_queue.size() || f_stmt_output.size() != f_stmt_usage.size())
+    if (f_outputs->size() != f_txn_id_queue.size() || f_outputs->size() != f_stmt_usage.size())
     {
         cerr << "dependency_analyzer: total_output, final_tid_queue and final_stmt_usage size are not equal" << endl;
         throw runtime_error("dependency_analyzer: total_output, final_tid_queue and final_stmt_usage size are not equal");
     }
 
     cerr << "Building dependency graph...          ";
-    stmt_num = f_stmt_output.size();
+    stmt_num = f_outputs->size();
 
     f_txn_status.push_back(TXN_COMMIT); // for init txn;
 
-    for (int txn_id = 0; txn_id < tid_num; txn_id++)
+    f_txn_size.assign(tid_num, 0);
+    f_txn_stmt_pos.assign(tid_num, vector<int>());
+    f_queue_stmt_id.reserve(stmt_num);
+    for (int i = 0; i < stmt_num; i++)
     {
-        int txn_stmt_num = 0;
-        for (int i = 0; i < stmt_num; i++)
-        {
-            if (f_txn_id_queue[i] == txn_id)
-                txn_stmt_num++;
-        }
-        f_txn_size.push_back(txn_stmt_num);
+        auto tid = f_txn_id_queue[i];
+        if (tid < 0 || tid >= tid_num)
+            throw runtime_error("dependency_analyzer: txn " + to_string(tid) + " of stmt " + to_string(i) + " is out of range");
+        f_queue_stmt_id.push_back(stmt_id(tid, f_txn_size[tid]));
+        f_txn_stmt_pos[tid].push_back(i);
+        f_txn_size[tid]++;
     }
 
     dependency_graph = new set<dependency_type> *[tid_num];
     for (int i = 0; i < tid_num; i++)
         dependency_graph[i] = new set<dependency_type>[tid_num];
 
-    // Add versions added the init transaction.
-    for (auto &each_output : init_output)
-    {
-        if (each_output.empty())
-            continue;
-        for (auto &row : each_output)
-        {
-            auto row_id = stoi(row[primary_key_idx]);
-            auto write_op_id = stoi(row[write_op_key_idx]);
-            auto hash = hash_output(row);
-            hash_to_output[hash] = row;
-            operate_unit op(stmt_usage(AFTER_WRITE_READ, false), write_op_id, tid_num - 1, -1, row_id, hash);
-            h.insert_to_history(op);
-        }
-    }
+    // Versions added the init transaction.
+    vector<operate_unit> init_ops;
+    init_ops.reserve(f_init_outputs->rows.size());
+    for (int r = 0; r < f_init_outputs->rows.size(); r++)
+        init_ops.emplace_back(stmt_usage(AFTER_WRITE_READ, false), f_init_outputs->version[r], tid_num - 1, -1,
+                              f_init_outputs->pk[r], f_init_outputs->hash[r]);
+
+    h.row_op_num.reserve(init_ops.size());
+    for (auto &op : init_ops)
+        h.row_op_num[op.row_id]++;
+    for (auto row_id : f_outputs->pk)
+        h.row_op_num[row_id]++;
+    h.reserve();
+    for (auto &op : init_ops)
+        h.insert_to_history(op);
 
     // Add versions added by other transactions.
     for (int i = 0; i < stmt_num; i++)
     {
-        auto &each_output = f_stmt_output[i];
         auto tid = f_txn_id_queue[i];
-        auto stmt_u = f_stmt_usage[i];
+        auto &stmt_u = f_stmt_usage[i];
 
         // do not analyze empty output select read;
         // write operation (insert, delete, update) will be analzye by using before/after-write read
-        if (each_output.empty())
-            continue;
-
-        for (auto &row : each_output)
+        for (int r = f_outputs->row_begin[i]; r < f_outputs->row_begin[i + 1]; r++)
         {
-            auto row_id = stoi(row[primary_key_idx]);
-            auto write_op_id = stoi(row[write_op_key_idx]);
-            auto hash = hash_output(row);
-            hash_to_output[hash] = row;
-            operate_unit op(stmt_u, write_op_id, tid, i, row_id, hash);
+            operate_unit op(stmt_u, f_outputs->version[r], tid, i, f_outputs->pk[r], f_outputs->hash[r]);
             h.insert_to_history(op);
         }
     }
@@ -1400,19 +1419,11 @@ bool dependency_analyzer::check_G1b()
                 {
                     cerr << "first_write_idx: " << i << endl;
                     cerr << "tid: " << tid << endl;
-                    cerr << "outpout: " << endl;
-                    auto &first_write_row = hash_to_output[op_list[i].hash];
-                    for (int e = 0; e < first_write_row.size(); e++)
-                        cerr << first_write_row[e] << " ";
-                    cerr << endl;
+                    cerr << "outpout: " << op_row(op_list[i]) << endl;
 
                     cerr << "other_read_idx: " << other_read_idx << endl;
                     cerr << "tid: " << op_list[other_read_idx].tid << endl;
-                    cerr << "outpout: " << endl;
-                    auto &read_row = hash_to_output[op_list[other_read_idx].hash];
-                    for (int e = 0; e < read_row.size(); e++)
-                        cerr << read_row[e] << " ";
-                    cerr << endl;
+                    cerr << "outpout: " << op_row(op_list[other_read_idx]) << endl;
 
                     cerr << "second_write_idx: " << second_write_idx << endl;
                     cerr << "tid: " << op_list[second_write_idx].tid << endl;
@@ -1677,7 +1688,7 @@ bool dependency_analyzer::check_GSIa()
                             continue;
 
                         // Try to find the dependency.
-                        auto it = stmt_dependency_graph.find({stmt_id(f_txn_id_queue, k), stmt_id(f_txn_id_queue, l)});
+                        auto it = stmt_dependency_graph.find({to_stmt_id(k), to_stmt_id(l)});
                         if (it != stmt_dependency_graph.end())
                         {
                             for (auto &dep : it->second)
@@ -1817,13 +1828,13 @@ vector<stmt_id> dependency_analyzer::longest_stmt_path(
     set<stmt_id> real_deleted_node; // to delete cycle
     for (int i = 0; i < stmt_num; i++)
     {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         dist_length[stmt_i] = 0;
     }
     set<stmt_id> all_stmt_set;
     for (int i = 0; i < stmt_num; i++)
     {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         all_stmt_set.insert(stmt_i);
     }
 
@@ -1835,7 +1846,7 @@ vector<stmt_id> dependency_analyzer::longest_stmt_path(
         // --- find zero-indegree statement ---
         for (int i = 0; i < stmt_num; i++)
         {
-            auto stmt_i = stmt_id(f_txn_id_queue, i);
+            auto stmt_i = to_stmt_id(i);
             if (delete_node.count(stmt_i) > 0) // has been deleted from tmp_stmt_graph
                 continue;
             if (real_deleted_node.count(stmt_i) > 0) // // has been really deleted (for decycle)
@@ -1843,7 +1854,7 @@ vector<stmt_id> dependency_analyzer::longest_stmt_path(
             bool has_indegree = false;
             for (int j = 0; j < stmt_num; j++)
             {
-                auto stmt_j = stmt_id(f_txn_id_queue, j);
+                auto stmt_j = to_stmt_id(j);
                 if (tmp_stmt_graph.count(make_pair(stmt_j, stmt_i)) > 0)
                 {
                     has_indegree = true;
@@ -1874,16 +1885,16 @@ vector<stmt_id> dependency_analyzer::longest_stmt_path(
 
             // delete its set (version_set, before_read, itself, after_read)
             auto select_stmt_id = *select_one_it;
-            auto select_queue_idx = select_stmt_id.transfer_2_stmt_idx(f_txn_id_queue);
+            auto select_queue_idx = to_stmt_idx(select_stmt_id);
             auto select_idx_set = get_instrumented_stmt_set(select_queue_idx);
             for (auto chosen_idx : select_idx_set)
             {
-                auto chosen_stmt_id = stmt_id(f_txn_id_queue, chosen_idx);
+                auto chosen_stmt_id = to_stmt_id(chosen_idx);
                 real_deleted_node.insert(chosen_stmt_id);
                 for (int i = 0; i < stmt_num; i++)
                 {
-                    auto out_branch = make_pair(chosen_stmt_id, stmt_id(f_txn_id_queue, i));
-                    auto in_branch = make_pair(stmt_id(f_txn_id_queue, i), chosen_stmt_id);
+                    auto out_branch = make_pair(chosen_stmt_id, to_stmt_id(i));
+                    auto in_branch = make_pair(to_stmt_id(i), chosen_stmt_id);
                     tmp_stmt_graph.erase(out_branch);
                     tmp_stmt_graph.erase(in_branch);
                 }
@@ -1897,10 +1908,10 @@ vector<stmt_id> dependency_analyzer::longest_stmt_path(
         // if do has zero-indegree statement
         int cur_max_length = 0;
         stmt_id cur_max_dad;
-        auto stmt_zero_idx = stmt_id(f_txn_id_queue, zero_indegree_idx);
+        auto stmt_zero_idx = to_stmt_id(zero_indegree_idx);
         for (int i = 0; i < stmt_num; i++)
         {
-            auto stmt_i = stmt_id(f_txn_id_queue, i);
+            auto stmt_i = to_stmt_id(i);
             if (real_deleted_node.count(stmt_i) > 0) // // has been really deleted (for decycle)
                 continue;
             auto branch = make_pair(stmt_i, stmt_zero_idx);
@@ -1918,7 +1929,7 @@ vector<stmt_id> dependency_analyzer::longest_stmt_path(
         delete_node.insert(stmt_zero_idx);
         for (int j = 0; j < stmt_num; j++)
         {
-            auto branch = make_pair(stmt_zero_idx, stmt_id(f_txn_id_queue, j));
+            auto branch = make_pair(stmt_zero_idx, to_stmt_id(j));
             tmp_stmt_graph.erase(branch);
         }
     }
@@ -1928,7 +1939,7 @@ vector<stmt_id> dependency_analyzer::longest_stmt_path(
     stmt_id longest_dist_stmt;
     for (int i = 0; i < stmt_num; i++)
     {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         if (real_deleted_node.count(stmt_i) > 0) // // has been really deleted (for decycle)
             continue;
         auto path_length = dist_length[stmt_i];
@@ -1956,12 +1967,12 @@ vector<stmt_id> dependency_analyzer::longest_stmt_path()
     {
         if (f_txn_status[f_txn_id_queue[i]] != TXN_COMMIT)
             continue;
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         for (int j = 0; j < stmt_num; j++)
         {
             if (f_txn_status[f_txn_id_queue[j]] != TXN_COMMIT)
                 continue;
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
+            auto stmt_j = to_stmt_id(j);
             auto branch = make_pair(stmt_i, stmt_j);
             if (stmt_dependency_graph.count(branch) == 0)
                 continue;
@@ -2003,7 +2014,7 @@ vector<stmt_id> dependency_analyzer::longest_stmt_path()
     // delete replaced stmt
     for (int i = 0; i < path_size; i++)
     {
-        auto queue_idx = path[i].transfer_2_stmt_idx(f_txn_id_queue);
+        auto queue_idx = to_stmt_idx(path[i]);
         if (f_stmt_usage[queue_idx] != INIT_TYPE)
             continue;
         path.erase(path.begin() + i);
@@ -2024,7 +2035,7 @@ vector<stmt_id> dependency_analyzer::topological_sort_path(set<stmt_id> deleted_
     set<stmt_id> all_stmt_set;   // record all stmts in the graph
     for (int i = 0; i < stmt_num; i++)
     {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         all_stmt_set.insert(stmt_i);
     }
 
@@ -2039,11 +2050,11 @@ vector<stmt_id> dependency_analyzer::topological_sort_path(set<stmt_id> deleted_
         auto txn_id = f_txn_id_queue[i];
         if (f_txn_status[txn_id] == TXN_COMMIT)
             continue;
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         deleted_nodes.insert(stmt_i);
         for (int j = 0; j < stmt_num; j++)
         {
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
+            auto stmt_j = to_stmt_id(j);
             auto out_branch = make_pair(stmt_i, stmt_j);
             auto in_branch = make_pair(stmt_j, stmt_i);
             tmp_stmt_dependency_graph.erase(out_branch);
@@ -2054,10 +2065,10 @@ vector<stmt_id> dependency_analyzer::topological_sort_path(set<stmt_id> deleted_
     // delete start and inner dependency
     for (int i = 0; i < stmt_num; i++)
     {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         for (int j = i; j < stmt_num; j++)
         {
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
+            auto stmt_j = to_stmt_id(j);
             auto out_branch = make_pair(stmt_i, stmt_j);
             auto in_branch = make_pair(stmt_j, stmt_i);
             if (tmp_stmt_dependency_graph.count(out_branch))
@@ -2088,7 +2099,7 @@ vector<stmt_id> dependency_analyzer::topological_sort_path(set<stmt_id> deleted_
         { // use reverse order as possible
             if (checked_idx.count(i) > 0)
                 continue;
-            auto stmt_i = stmt_id(f_txn_id_queue, i);
+            auto stmt_i = to_stmt_id(i);
             if (outputted_node.count(stmt_i) > 0) // has been outputted from tmp_stmt_graph
                 continue;
             if (deleted_nodes.count(stmt_i) > 0) // has been really deleted (for decycle)
@@ -2101,12 +2112,12 @@ vector<stmt_id> dependency_analyzer::topological_sort_path(set<stmt_id> deleted_
             for (auto chosen_idx : i_idx_set)
             {
                 checked_idx.insert(chosen_idx);
-                auto stmt_chosen_idx = stmt_id(f_txn_id_queue, chosen_idx);
+                auto stmt_chosen_idx = to_stmt_id(chosen_idx);
                 for (int j = 0; j < stmt_num; j++)
                 {
                     if (i_idx_set.count(j) > 0) // exclude self ring
                         continue;
-                    auto stmt_j = stmt_id(f_txn_id_queue, j);
+                    auto stmt_j = to_stmt_id(j);
                     auto in_branch = make_pair(stmt_j, stmt_chosen_idx);
                     if (tmp_stmt_dependency_graph.count(in_branch) == 0)
                         continue;
@@ -2144,7 +2155,7 @@ vector<stmt_id> dependency_analyzer::topological_sort_path(set<stmt_id> deleted_
                 if (checked_idx_for_delete.count(i) > 0)
                     continue;
 
-                auto stmt_i = stmt_id(f_txn_id_queue, i);
+                auto stmt_i = to_stmt_id(i);
                 if (outputted_node.count(stmt_i) > 0) // has been outputted from tmp_stmt_graph
                     continue;
                 if (deleted_nodes.count(stmt_i) > 0) // has been really deleted (for decycle)
@@ -2155,13 +2166,13 @@ vector<stmt_id> dependency_analyzer::topological_sort_path(set<stmt_id> deleted_
                 for (auto chosen_idx : i_idx_set)
                 {
                     checked_idx_for_delete.insert(chosen_idx);
-                    auto stmt_chosen_idx = stmt_id(f_txn_id_queue, chosen_idx);
+                    auto stmt_chosen_idx = to_stmt_id(chosen_idx);
                     for (int j = 0; j < stmt_num; j++)
                     {
                         if (i_idx_set.count(j) > 0) // exclude self ring
                             continue;
 
-                        auto stmt_j = stmt_id(f_txn_id_queue, j);
+                        auto stmt_j = to_stmt_id(j);
                         auto in_branch = make_pair(stmt_j, stmt_chosen_idx);
                         if (tmp_stmt_dependency_graph.count(in_branch) > 0)
                             edge_num++;
@@ -2177,20 +2188,20 @@ vector<stmt_id> dependency_analyzer::topological_sort_path(set<stmt_id> deleted_
                     target_idx = i;
                 }
             }
-            auto select_stmt_id = stmt_id(f_txn_id_queue, target_idx);
+            auto select_stmt_id = to_stmt_id(target_idx);
 
             // delete its set (version_set, before_read, itself, after_read)
-            auto select_queue_idx = select_stmt_id.transfer_2_stmt_idx(f_txn_id_queue);
+            auto select_queue_idx = to_stmt_idx(select_stmt_id);
             auto select_idx_set = get_instrumented_stmt_set(select_queue_idx);
             // cerr << "Delete nodes: ";
             for (auto chosen_idx : select_idx_set)
             {
-                auto chosen_stmt_id = stmt_id(f_txn_id_queue, chosen_idx);
+                auto chosen_stmt_id = to_stmt_id(chosen_idx);
                 deleted_nodes.insert(chosen_stmt_id);
                 for (int i = 0; i < stmt_num; i++)
                 {
-                    auto out_branch = make_pair(chosen_stmt_id, stmt_id(f_txn_id_queue, i));
-                    auto in_branch = make_pair(stmt_id(f_txn_id_queue, i), chosen_stmt_id);
+                    auto out_branch = make_pair(chosen_stmt_id, to_stmt_id(i));
+                    auto in_branch = make_pair(to_stmt_id(i), chosen_stmt_id);
                     tmp_stmt_dependency_graph.erase(out_branch);
                     tmp_stmt_dependency_graph.erase(in_branch);
                 }
@@ -2205,14 +2216,14 @@ vector<stmt_id> dependency_analyzer::topological_sort_path(set<stmt_id> deleted_
         set<int, less<int>> zero_idx_set = get_instrumented_stmt_set(zero_indegree_idx);
         for (auto output_idx : zero_idx_set)
         {
-            auto output_stmt_id = stmt_id(f_txn_id_queue, output_idx);
+            auto output_stmt_id = to_stmt_id(output_idx);
             path.push_back(output_stmt_id);
 
             // mark the outputted node, and delete its edges.
             outputted_node.insert(output_stmt_id);
             for (int j = 0; j < stmt_num; j++)
             {
-                auto stmt_j = stmt_id(f_txn_id_queue, j);
+                auto stmt_j = to_stmt_id(j);
                 auto out_branch = make_pair(output_stmt_id, stmt_j);
                 auto in_branch = make_pair(stmt_j, output_stmt_id);
                 tmp_stmt_dependency_graph.erase(out_branch);
@@ -2238,7 +2249,7 @@ vector<stmt_id> dependency_analyzer::topological_sort_path(set<stmt_id> deleted_
     // delete replaced stmts
     for (int i = 0; i < path_size; i++)
     {
-        auto queue_idx = path[i].transfer_2_stmt_idx(f_txn_id_queue);
+        auto queue_idx = to_stmt_idx(path[i]);
         if (f_stmt_usage[queue_idx] != INIT_TYPE)
             continue;
         path.erase(path.begin() + i);
@@ -2325,11 +2336,11 @@ vector<vector<stmt_id>> dependency_analyzer::get_all_topo_sort_path()
         auto txn_id = f_txn_id_queue[i];
         if (f_txn_status[txn_id] == TXN_COMMIT)
             continue;
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         deleted_nodes.insert(stmt_i);
         for (int j = 0; j < stmt_num; j++)
         {
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
+            auto stmt_j = to_stmt_id(j);
             auto out_branch = make_pair(stmt_i, stmt_j);
             auto in_branch = make_pair(stmt_j, stmt_i);
             tmp_stmt_dependency_graph.erase(out_branch);
@@ -2341,11 +2352,11 @@ vector<vector<stmt_id>> dependency_analyzer::get_all_topo_sort_path()
     {
         if (f_stmt_usage[i] != INIT_TYPE)
             continue;
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         deleted_nodes.insert(stmt_i);
         for (int j = 0; j < stmt_num; j++)
         {
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
+            auto stmt_j = to_stmt_id(j);
             auto out_branch = make_pair(stmt_i, stmt_j);
             auto in_branch = make_pair(stmt_j, stmt_i);
             tmp_stmt_dependency_graph.erase(out_branch);
@@ -2356,10 +2367,10 @@ vector<vector<stmt_id>> dependency_analyzer::get_all_topo_sort_path()
     // delete start and inner dependency
     for (int i = 0; i < stmt_num; i++)
     {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         for (int j = i; j < stmt_num; j++)
         {
-            auto stmt_j = stmt_id(f_txn_id_queue, j);
+            auto stmt_j = to_stmt_id(j);
             auto out_branch = make_pair(stmt_i, stmt_j);
             auto in_branch = make_pair(stmt_j, stmt_i);
             if (tmp_stmt_dependency_graph.count(out_branch))
@@ -2389,7 +2400,7 @@ vector<vector<stmt_id>> dependency_analyzer::get_all_topo_sort_path()
         path_nodes_set.insert(node);
     for (int i = 0; i < stmt_num; i++)
     {
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         if (path_nodes_set.count(stmt_i) == 0)
             deleted_nodes.insert(stmt_i);
     }
@@ -2408,7 +2419,7 @@ void dependency_analyzer::recur_topo_sort(vector<stmt_id> current_path,
     {
         if (visited_instrument.count(i) > 0)
             continue;
-        auto stmt_i = stmt_id(f_txn_id_queue, i);
+        auto stmt_i = to_stmt_id(i);
         if (deleted_nodes.count(stmt_i) > 0) // has been visited
             continue;
         bool has_indegree = false;
@@ -2419,12 +2430,12 @@ void dependency_analyzer::recur_topo_sort(vector<stmt_id> current_path,
         for (auto chosen_idx : i_idx_set)
         {
             visited_instrument.insert(chosen_idx);
-            auto stmt_chosen_idx = stmt_id(f_txn_id_queue, chosen_idx);
+            auto stmt_chosen_idx = to_stmt_id(chosen_idx);
             for (int j = 0; j < stmt_num; j++)
             {
                 if (i_idx_set.count(j) > 0) // exclude self ring
                     continue;
-                auto stmt_j = stmt_id(f_txn_id_queue, j);
+                auto stmt_j = to_stmt_id(j);
                 if (deleted_nodes.count(stmt_j) > 0) // has been visited
                     continue;
 
@@ -2445,7 +2456,7 @@ void dependency_analyzer::recur_topo_sort(vector<stmt_id> current_path,
         auto tmp_deleted_nodes = deleted_nodes;
         for (auto idx : i_idx_set)
         {
-            auto chosen_stmt_id = stmt_id(f_txn_id_queue, idx);
+            auto chosen_stmt_id = to_stmt_id(idx);
             current_path.push_back(chosen_stmt_id);
             deleted_nodes.insert(chosen_stmt_id);
         }
@@ -2456,7 +2467,7 @@ void dependency_analyzer::recur_topo_sort(vector<stmt_id> current_path,
         // deleted_nodes = tmp_deleted_nodes;
         for (auto idx : i_idx_set)
         {
-            auto chosen_stmt_id = stmt_id(f_txn_id_queue, idx);
+            auto chosen_stmt_id = to_stmt_id(idx);
             current_path.pop_back();
             deleted_nodes.erase(chosen_stmt_id);
         }
@@ -2478,3 +2489,65 @@ void dependency_analyzer::recur_topo_sort(vector<stmt_id> current_path,
     }
     return;
 }
+
+static double elapsed_ms(chrono::steady_clock::time_point begin)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+void history_benchmark()
+{
+    // rows, operations: growing histories, then a few hot rows
+    vector<pair<int, int>> sizes = {{1000, 10000}, {10000, 100000}, {100000, 1000000}, {100, 1000000}};
+    stmt_basic_type usages[] = {SELECT_READ, BEFORE_WRITE_READ, AFTER_WRITE_READ};
+
+    cerr << "     rows        ops   build ms    scan ms  lookup ms  build ns/op" << endl;
+    for (auto [row_num, op_num] : sizes)
+    {
+        mt19937 rng(row_num ^ op_num);
+        // sparse rowids, as the primary keys of the generated tables
+        vector<int> row_ids(row_num);
+        for (auto &row_id : row_ids)
+            row_id = rng() & 0x3fffffff;
+
+        vector<operate_unit> ops;
+        ops.reserve(op_num);
+        for (int i = 0; i < op_num; i++)
+        {
+            auto row_id = row_ids[rng() % row_num];
+            stmt_usage use(usages[i % 3], true);
+            ops.emplace_back(use, i, rng() % 64, i / 4, row_id, rng());
+        }
+
+        // the way dependency_analyzer builds it
+        auto begin = chrono::steady_clock::now();
+        history h;
+        for (auto &op : ops)
+            h.row_op_num[op.row_id]++;
+        h.reserve();
+        for (auto &op : ops)
+            h.insert_to_history(op);
+        auto build_ms = elapsed_ms(begin);
+
+        // a pass over the op lists, as the dependency builders do
+        begin = chrono::steady_clock::now();
+        size_t checksum = 0;
+        for (auto &rch : h.change_history)
+        {
+            for (auto &op : rch.row_op_list)
+                checksum += op.write_op_id;
+        }
+        auto scan_ms = elapsed_ms(begin);
+
+        begin = chrono::steady_clock::now();
+        for (auto &op : ops)
+            checksum += h.find_row(op.row_id)->row_op_list.size();
+        auto lookup_ms = elapsed_ms(begin);
+
+        cerr << setw(9) << row_num << setw(11) << op_num
+             << fixed << setprecision(1)
+             << setw(11) << build_ms << setw(11) << scan_ms << setw(11) << lookup_ms
+             << setw(13) << build_ms * 1e6 / op_num
+             << (checksum == 0 ? " (empty)" : "") << endl;
+    }
+}
@@ -13,6 +13,7 @@
 #include "instrumentor.hh"
 #include <vector>
 #include <set>
+#include <unordered_map>
 #include <algorithm>
 
 using namespace std;
@@ -44,6 +45,34 @@ typedef vector<string> row_output;
 // one output consits of several rows -> vector <vector <string>>
 typedef vector<row_output> stmt_output;
 
+size_t hash_output(const row_output &row);
+
+/**
+ * The output rows of a sequence of statements, kept in one flat list.
+ * The primary key, version and hash of each row are parsed when its
+ * statement is appended, so that the analysis never goes back to the strings.
+ * The rows of statement i are [row_begin[i], row_begin[i + 1]).
+ */
+struct recorded_outputs
+{
+    recorded_outputs(int primary_key_idx, int write_op_key_idx);
+    // appends the output of the next statement
+    void append(stmt_output &&output);
+    // number of statements
+    int size() const { return row_begin.size() - 1; }
+
+    // Index of the PK in the output of a statement.
+    int primary_key_index;
+    // Index if the version key in the output of a statement.
+    int version_key_index;
+
+    vector<int> row_begin;
+    vector<row_output> rows;
+    vector<int> pk;
+    vector<int> version;
+    vector<size_t> hash;
+};
+
 /**
  * Seems to be an entry to the history vector??
  */
@@ -78,13 +107,31 @@ struct row_change_history
 
 /**
  * Stores the history of the updates done to rows of the database.
+ * The rows are in the order of their first operation, and found by rowid
+ * through row_idx.
  */
 struct history
 {
     vector<row_change_history> change_history;
+    // index in change_history of each rowid
+    unordered_map<int, int> row_idx;
+    // number of operations that will be inserted on each rowid, so that the
+    // op list of a row is allocated once
+    unordered_map<int, int> row_op_num;
+
+    // sizes the history for the operations counted by row_op_num
+    void reserve();
     void insert_to_history(operate_unit &oper_unit);
+    // history of row_id, NULL if it has no operation
+    row_change_history *find_row(int row_id);
 };
 
+/**
+ * Times the construction and a scan of synthetic histories of growing
+ * sizes, and prints the time per operation. Run by --history-benchmark.
+ */
+void history_benchmark();
+
 struct stmt_id
 {
     int txn_id;
@@ -119,17 +166,18 @@ struct stmt_id
 
 struct dependency_analyzer
 {
-    dependency_analyzer(vector<stmt_output> &init_output,
-                        vector<stmt_output> &total_output,
+    dependency_analyzer(shared_ptr<const recorded_outputs> init_output,
+                        shared_ptr<const recorded_outputs> total_output,
                         vector<int> &final_tid_queue,
                         vector<stmt_usage> &final_stmt_usage,
                         vector<txn_status> &final_txn_status,
-                        int t_num,
-                        int primary_key_idx,
-                        int write_op_key_idx);
+                        int t_num);
     ~dependency_analyzer();
 
-    size_t hash_output(row_output &row);
+    // stmt_id(f_txn_id_queue, stmt_idx) and
+    // id.transfer_2_stmt_idx(f_txn_id_queue), without scanning the queue
+    stmt_id to_stmt_id(int stmt_idx) { return f_queue_stmt_id[stmt_idx]; }
+    int to_stmt_idx(const stmt_id &id);
 
     // Creates
     void build_predicate_dependency(vector<operate_unit> &op_list, int predicate_idx);
@@ -142,6 +190,9 @@ struct dependency_analyzer
      */
     void build_directly_read_dependency(vector<operate_unit> &op_list, int op_idx);
 
+    // the row read or written by op, for error reports
+    string op_row(const operate_unit &op);
+
     /**
      * Finds who read an overwriten value and adds the RW dependency.
      *
@@ -251,23 +302,24 @@ struct dependency_analyzer
     int *tid_strict_begin_idx; // idx of start transaction
     int *tid_end_idx;
 
-    // Index of the PK in the output of a statement.
-    int primary_key_index;
-    // Index if the version key in the output of a statement.
-    int version_key_index;
-
     // Status of the transactions (aborted / committed / undefined).
     vector<txn_status> f_txn_status;
     // The id of the transactions in the order of the appearence of statements.
     vector<int> f_txn_id_queue;
     // Number of statements in each transaction.
     vector<int> f_txn_size;
+    // stmt_id of each position of f_txn_id_queue, and back: the position of
+    // the stmt_idx_in_txn-th statement of txn_id is
+    // f_txn_stmt_pos[txn_id][stmt_idx_in_txn].
+    vector<stmt_id> f_queue_stmt_id;
+    vector<vector<int>> f_txn_stmt_pos;
     // Type of the executed statements.
     vector<stmt_usage> f_stmt_usage;
-    // Output of the statements.
-    vector<stmt_output> f_stmt_output;
-    // Hash of the output of statements.
-    map<int, row_output> hash_to_output;
+    // Rows of the initial database content, and output rows of the
+    // statements. Shared with the test, which starts new ones for its
+    // next run instead of clearing these.
+    shared_ptr<const recorded_outputs> f_init_outputs;
+    shared_ptr<const recorded_outputs> f_outputs;
 
     // dependency_graph[i][j] = set of dependencies of txn i over j
     set<dependency_type> **dependency_graph;
@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 
 #include "prod.hh"
 
@@ -65,6 +66,51 @@ struct dut_base
     virtual string begin_stmt() = 0;
 
     virtual void get_content(vector<string> &tables_name, map<string, vector<vector<string>>> &content) = 0;
+
+    // Non-blocking execution, driven by stmt_executor.
+    // async_test() sends stmt (or continues the one already sent) and returns
+    // true when it has finished, false if it is still waiting for the server.
+    // A dut without a non-blocking client falls back to the blocking test().
+    virtual bool async_test(const string &stmt, vector<vector<string>> *output = NULL, int *affected_row_num = NULL)
+    {
+        test(stmt, output, affected_row_num);
+        return true;
+    }
+    // Same as async_test(), but stmt may run as a server-side prepared
+    // statement that is prepared once per connection. Falls back to the text
+    // protocol when the dut or the statement does not support it.
+    virtual bool async_test_prepared(const string &stmt, vector<vector<string>> *output = NULL, int *affected_row_num = NULL)
+    {
+        return async_test(stmt, output, affected_row_num);
+    }
+    // Hint that next_stmts are run on this connection right after stmt.
+    // A dut that can pipeline sends them with stmt in one multi-statement
+    // packet, and hands their results to the following async_test() calls.
+    virtual void pipeline(const string &stmt, const vector<string> &next_stmts)
+    {
+        (void)stmt;
+        (void)next_stmts;
+    }
+    // socket to wait on while async_test() is not finished, -1 if none
+    virtual int socket_fd() { return -1; }
+    // true if the in-flight statement is waiting for a lock of another txn
+    virtual bool is_blocked() { return false; }
+    // server session id of this connection, 0 if unknown
+    virtual unsigned long session_id() { return 0; }
+    // sessions holding the locks the in-flight statement waits for,
+    // empty if they cannot be told
+    virtual void lock_holders(set<unsigned long> &sessions) { sessions.clear(); }
+
+    // In-server snapshot of the tables, so that restoring the backup does not
+    // leave the server. save_snapshot() copies the tables aside, and
+    // restore_snapshot() copies them back, or returns false if it cannot.
+    virtual void save_snapshot() {}
+    virtual bool restore_snapshot() { return false; }
+
+    // Brings the session back to a freshly connected state so that the
+    // connection can be reused by dut_setup(). Returns false if that is not
+    // possible cheaply, and the connection is closed instead.
+    virtual bool reset_session() { return false; }
 };
 
 #endif
\ No newline at end of file
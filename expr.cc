@@ -14,11 +14,6 @@
 using namespace std;
 using impedance::matched;
 
-extern int in_update_set_list;
-extern set<string> update_used_column_ref;
-extern int use_group;       // 0->no group, 1->use group, 2->to_be_define
-extern int in_in_clause;    // 0-> not in "in" clause, 1-> in "in" clause (cannot use limit)
-extern int in_check_clause; // 0-> not in "check" clause, 1-> in "check" clause (cannot use subquery)
 
 shared_ptr<value_expr> value_expr::factory(prod *p, sqltype *type_constraint,
                                            vector<shared_ptr<named_relation>> *prefer_refs)
@@ -48,7 +43,7 @@ shared_ptr<value_expr> value_expr::factory(prod *p, sqltype *type_constraint,
         }
         auto choice = d42();
 #ifndef TEST_MONETDB // monetdb dont allow limit in subquery, which make subselect return more than one row
-        if (!in_check_clause && !in_in_clause && choice <= 4)
+        if (!smith::ctx().in_check_clause && !smith::ctx().in_in_clause && choice <= 4)
             return make_shared<atomic_subselect>(p, type_constraint);
 #endif
         if (p->scope->refs.size() && choice <= 40)
@@ -149,11 +144,11 @@ column_reference::column_reference(prod *p, sqltype *type_constraint,
             assert(type_constraint->consistent(type));
 
             // in update_stmt, the column_ref cannot be used twice.
-            if (in_update_set_list == 0)
+            if (smith::ctx().in_update_set_list == 0)
                 break;
-            if (update_used_column_ref.count(reference) == 0)
+            if (smith::ctx().update_used_column_ref.count(reference) == 0)
             {
-                update_used_column_ref.insert(reference);
+                smith::ctx().update_used_column_ref.insert(reference);
                 break;
             }
             retry();
@@ -175,11 +170,11 @@ column_reference::column_reference(prod *p, sqltype *type_constraint,
             table_ref = r->ident();
 
             // in update_stmt, the column_ref cannot be used twice.
-            if (in_update_set_list == 0)
+            if (smith::ctx().in_update_set_list == 0)
                 break;
-            if (update_used_column_ref.count(reference) == 0)
+            if (smith::ctx().update_used_column_ref.count(reference) == 0)
             {
-                update_used_column_ref.insert(reference);
+                smith::ctx().update_used_column_ref.insert(reference);
                 break;
             }
             retry();
@@ -220,10 +215,10 @@ shared_ptr<bool_expr> bool_expr::factory(prod *p)
             return make_shared<like_op>(p);
         else if (choose <= 36)
             return make_shared<in_op>(p);
-        else if (!in_check_clause && choose <= 39)
+        else if (!smith::ctx().in_check_clause && choose <= 39)
             return make_shared<comp_subquery>(p);
 #if (!defined TEST_CLICKHOUSE)
-        else if (!in_check_clause)
+        else if (!smith::ctx().in_check_clause)
             return make_shared<exists_predicate>(p);
 #endif
         //     return make_shared<distinct_pred>(q);
@@ -630,13 +625,13 @@ in_op::in_op(prod *p) : bool_expr(p), myscope(scope)
     else
         in_operator = " not in ";
 
-    if (!in_check_clause && d6() < 6)
+    if (!smith::ctx().in_check_clause && d6() < 6)
         use_query = true;
     else
         use_query = false;
 
-    auto tmp_in_state = in_in_clause;
-    in_in_clause = 1;
+    auto tmp_in_state = smith::ctx().in_in_clause;
+    smith::ctx().in_in_clause = 1;
     if (!use_query)
     {
         auto vec_size = dx(5);
@@ -648,8 +643,8 @@ in_op::in_op(prod *p) : bool_expr(p), myscope(scope)
     }
     else
     {
-        auto tmp_use_group = use_group;
-        use_group = 0;
+        auto tmp_use_group = smith::ctx().use_group;
+        smith::ctx().use_group = 0;
         scope->refs.clear(); // dont use the ref of parent select
         vector<sqltype *> pointed_type;
         pointed_type.push_back(lhs->type);
@@ -657,9 +652,9 @@ in_op::in_op(prod *p) : bool_expr(p), myscope(scope)
             in_subquery = make_shared<unioned_query>(this, scope, false, &pointed_type);
         else
             in_subquery = make_shared<query_spec>(this, scope, false, &pointed_type);
-        use_group = tmp_use_group;
+        smith::ctx().use_group = tmp_use_group;
     }
-    in_in_clause = tmp_in_state;
+    smith::ctx().in_in_clause = tmp_in_state;
 }
 
 void in_op::out(std::ostream &out)
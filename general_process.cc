@@ -1,6 +1,15 @@
 #include "general_process.hh"
 
-extern int write_op_id;
+
+static unsigned long long get_cur_time_ms(void)
+{
+    struct timeval tv;
+    struct timezone tz;
+
+    gettimeofday(&tv, &tz);
+
+    return (tv.tv_sec * 1000ULL) + tv.tv_usec / 1000;
+}
 
 int make_dir_error_exit(string &folder)
 {
@@ -20,10 +29,10 @@ int make_dir_error_exit(string &folder)
     return 0;
 }
 
-shared_ptr<schema> get_schema(dbms_info &d_info)
+static shared_ptr<schema> load_schema(dbms_info &d_info)
 {
     shared_ptr<schema> schema;
-    static int try_time = 0;
+    auto &try_time = smith::ctx().schema_try_time;
 
     try
     {
@@ -38,7 +47,7 @@ shared_ptr<schema> get_schema(dbms_info &d_info)
 
 #ifdef HAVE_MARIADB
         else if (d_info.dbms_name == "mariadb")
-            schema = make_shared<schema_mariadb>(d_info.test_db, d_info.test_port);
+            schema = make_shared<schema_mariadb>(d_info.test_db, d_info.test_port, managed_server_socket(d_info));
 #endif
 
 #ifdef HAVE_TIDB
@@ -61,14 +70,80 @@ shared_ptr<schema> get_schema(dbms_info &d_info)
             throw e;
         }
         try_time++;
-        schema = get_schema(d_info);
+        schema = load_schema(d_info);
         try_time--;
         return schema;
     }
     return schema;
 }
 
-shared_ptr<dut_base> dut_setup(dbms_info &d_info)
+// DDL epoch of the database of the cached schema, bumped by
+// schema_changed(). Per thread, as each fuzzing loop has its own database,
+// and inherited by the test processes with the cached schema.
+static thread_local unsigned long schema_epoch = 0;
+
+struct schema_cache_entry
+{
+    string key; // dbms, database and port the schema was loaded from
+    unsigned long epoch = 0;
+    shared_ptr<schema> loaded;
+};
+static thread_local schema_cache_entry schema_cache;
+
+static string schema_cache_key(dbms_info &d_info)
+{
+    return d_info.dbms_name + "/" + d_info.test_db + "/" + to_string(d_info.test_port);
+}
+
+void schema_changed(dbms_info &d_info)
+{
+    // the cache holds a single database, the others are loaded anyway
+    if (schema_cache.key == schema_cache_key(d_info))
+        schema_epoch++;
+}
+
+static thread_local schema_load_stats load_stats;
+
+shared_ptr<schema> get_schema(dbms_info &d_info)
+{
+    auto key = schema_cache_key(d_info);
+    if (schema_cache.loaded && schema_cache.key == key && schema_cache.epoch == schema_epoch)
+    {
+        load_stats.hit++;
+        return schema_cache.loaded;
+    }
+
+    schema_cache.loaded = NULL;
+    auto begin_time = get_cur_time_ms();
+    auto loaded = load_schema(d_info);
+    auto load_ms = get_cur_time_ms() - begin_time;
+    load_stats.load++;
+    load_stats.total_ms += load_ms;
+    load_stats.max_ms = max(load_stats.max_ms, load_ms);
+
+    schema_cache.key = key;
+    schema_cache.epoch = schema_epoch;
+    schema_cache.loaded = loaded;
+    return loaded;
+}
+
+schema_load_stats schema_load_get_stats()
+{
+    return load_stats;
+}
+
+void schema_load_report()
+{
+    auto stats = schema_load_get_stats();
+    if (stats.load == 0)
+        return;
+    cerr << "schema: " << stats.load << " loaded, "
+         << stats.hit << " cached, "
+         << stats.total_ms / stats.load << " ms avg, "
+         << stats.max_ms << " ms max" << endl;
+}
+
+shared_ptr<dut_base> dut_connect(dbms_info &d_info)
 {
     shared_ptr<dut_base> dut;
     if (false)
@@ -81,7 +156,7 @@ shared_ptr<dut_base> dut_setup(dbms_info &d_info)
 
 #ifdef HAVE_MARIADB
     else if (d_info.dbms_name == "mariadb")
-        dut = make_shared<dut_mariadb>(d_info.test_db, d_info.test_port);
+        dut = make_shared<dut_mariadb>(d_info.test_db, d_info.test_port, managed_server_socket(d_info));
 #endif
 
 #ifdef HAVE_TIDB
@@ -98,6 +173,146 @@ shared_ptr<dut_base> dut_setup(dbms_info &d_info)
     return dut;
 }
 
+/**
+ * Warm connections behind dut_setup(), keyed by dbms_info.
+ * The pool belongs to the process that filled it. A forked child starts with
+ * an empty one, and drops the inherited connections with
+ * dut_drop_inherited().
+ */
+struct dut_pool
+{
+    map<string, vector<shared_ptr<dut_base>>> idle;
+    pid_t owner_pid;
+    int generation;
+    dut_pool_stats stats;
+};
+
+// one per thread, so that the --workers threads do not share connections
+static thread_local dut_pool *pool = NULL;
+// bumped by dut_pool_invalidate(), which drops the connections of every pool
+static atomic<int> pool_generation(0);
+
+/**
+ * Frees a connection inherited through fork(). Its socket is shared with the
+ * parent, so closing it as is would send COM_QUIT on the parent's session.
+ * The socket of this process is pointed at /dev/null first, and the
+ * connection then closes without reaching the server.
+ */
+static void dut_drop_inherited(shared_ptr<dut_base> &dut)
+{
+    auto fd = dut->socket_fd();
+    auto null_fd = fd >= 0 ? open("/dev/null", O_RDWR | O_CLOEXEC) : -1;
+    if (null_fd < 0 || dup2(null_fd, fd) < 0)
+    { // cannot be detached, keep it open
+        new shared_ptr<dut_base>(dut);
+    }
+    if (null_fd >= 0)
+        close(null_fd);
+    dut.reset();
+}
+
+static dut_pool *get_dut_pool()
+{
+    if (pool != NULL && pool->owner_pid != getpid())
+    { // inherited from the parent
+        for (auto &[key, idle] : pool->idle)
+        {
+            for (auto &dut : idle)
+                dut_drop_inherited(dut);
+        }
+        delete pool;
+        pool = NULL;
+    }
+    if (pool == NULL)
+    {
+        pool = new dut_pool();
+        pool->owner_pid = getpid();
+        pool->generation = pool_generation;
+        pool->stats = dut_pool_stats();
+    }
+    if (pool->generation != pool_generation)
+    {
+        pool->generation = pool_generation;
+        pool->idle.clear();
+    }
+    return pool;
+}
+
+static string dut_pool_key(dbms_info &d_info)
+{
+    return d_info.dbms_name + ":" + d_info.test_db + ":" + to_string(d_info.test_port);
+}
+
+static void dut_pool_release(const string &key, pid_t owner_pid, int generation, shared_ptr<dut_base> &dut)
+{
+    if (owner_pid != getpid())
+    { // handed out in the parent
+        dut_drop_inherited(dut);
+        return;
+    }
+
+    auto p = get_dut_pool();
+    auto &idle = p->idle[key];
+    if (generation != p->generation || idle.size() >= DUT_POOL_MAX_IDLE || !dut->reset_session())
+    {
+        p->stats.discard++;
+        return; // closed with the last reference
+    }
+    idle.push_back(dut);
+}
+
+shared_ptr<dut_base> dut_setup(dbms_info &d_info)
+{
+    auto p = get_dut_pool();
+    auto key = dut_pool_key(d_info);
+    auto &idle = p->idle[key];
+
+    shared_ptr<dut_base> dut;
+    if (!idle.empty())
+    {
+        dut = idle.back();
+        idle.pop_back();
+        p->stats.hit++;
+    }
+    else
+    {
+        dut = dut_connect(d_info);
+        p->stats.miss++;
+    }
+
+    // hand out an alias whose deleter gives the connection back to the pool
+    auto owner_pid = p->owner_pid;
+    auto generation = p->generation;
+    return shared_ptr<dut_base>(dut.get(), [dut, key, owner_pid, generation](dut_base *) mutable
+                                { dut_pool_release(key, owner_pid, generation, dut); });
+}
+
+void dut_pool_invalidate()
+{
+    pool_generation++;
+    get_dut_pool();
+}
+
+dut_pool_stats dut_pool_get_stats()
+{
+    return get_dut_pool()->stats;
+}
+
+void dut_pool_report()
+{
+    auto stats = dut_pool_get_stats();
+    cerr << "dut pool: " << stats.hit << " hit, "
+         << stats.miss << " miss, "
+         << stats.discard << " discard" << endl;
+}
+
+string normal_bug_file(dbms_info &d_info)
+{
+    if (d_info.worker_id < 0)
+        return NORMAL_BUG_FILE;
+    return "worker_" + to_string(d_info.worker_id) + "_" + NORMAL_BUG_FILE;
+}
+
 int save_backup_file(string path, dbms_info &d_info)
 {
     if (false)
@@ -105,17 +320,17 @@ int save_backup_file(string path, dbms_info &d_info)
     }
 #ifdef HAVE_MYSQL
     else if (d_info.dbms_name == "mysql")
-        return dut_mysql::save_backup_file(path);
+        return dut_mysql::save_backup_file(path, d_info.test_db, d_info.test_port);
 #endif
 
 #ifdef HAVE_MARIADB
     else if (d_info.dbms_name == "mariadb")
-        return dut_mariadb::save_backup_file(path);
+        return dut_mariadb::save_backup_file(path, d_info.test_db, d_info.test_port);
 #endif
 
 #ifdef HAVE_TIDB
     else if (d_info.dbms_name == "tidb")
-        return dut_tidb::save_backup_file(path);
+        return dut_tidb::save_backup_file(path, d_info.test_db, d_info.test_port);
 #endif
 
     else
@@ -125,24 +340,33 @@ int save_backup_file(string path, dbms_info &d_info)
     }
 }
 
+// databases for which dut_backup() has saved an in-server snapshot matching
+// the backup file; inherited by the test processes the thread forks
+static thread_local set<string> snapshot_dbs;
+
 int use_backup_file(string backup_file, dbms_info &d_info)
 {
+    // the snapshot in the server belongs to another backup, and so may the
+    // tables restored from it
+    snapshot_dbs.erase(d_info.test_db);
+    schema_changed(d_info);
+
     if (false)
     {
     }
 #ifdef HAVE_MYSQL
     else if (d_info.dbms_name == "mysql")
-        return dut_mysql::use_backup_file(backup_file);
+        return dut_mysql::use_backup_file(backup_file, d_info.test_db, d_info.test_port);
 #endif
 
 #ifdef HAVE_MARIADB
     else if (d_info.dbms_name == "mariadb")
-        return dut_mariadb::use_backup_file(backup_file);
+        return dut_mariadb::use_backup_file(backup_file, d_info.test_db, d_info.test_port);
 #endif
 
 #ifdef HAVE_TIDB
     else if (d_info.dbms_name == "tidb")
-        return dut_tidb::use_backup_file(backup_file);
+        return dut_tidb::use_backup_file(backup_file, d_info.test_db, d_info.test_port);
 #endif
 
     else
@@ -161,12 +385,12 @@ pid_t fork_db_server(dbms_info &d_info)
 
 #ifdef HAVE_MYSQL
     else if (d_info.dbms_name == "mysql")
-        fork_pid = dut_mysql::fork_db_server();
+        fork_pid = dut_mysql::fork_db_server(d_info.server_id, d_info.test_port, d_info.server_profile);
 #endif
 
 #ifdef HAVE_MARIADB
     else if (d_info.dbms_name == "mariadb")
-        fork_pid = dut_mariadb::fork_db_server();
+        fork_pid = dut_mariadb::fork_db_server(d_info.server_id, d_info.test_port, d_info.server_profile);
 #endif
 
 #ifdef HAVE_OCEANBASE
@@ -193,6 +417,28 @@ pid_t fork_db_server(dbms_info &d_info)
     return fork_pid;
 }
 
+void save_server_profile(string path, dbms_info &d_info)
+{
+    vector<string> args;
+    if (false)
+    {
+    }
+#ifdef HAVE_MYSQL
+    else if (d_info.dbms_name == "mysql")
+        dut_mysql::server_profile_args(d_info.server_profile, args);
+#endif
+
+#ifdef HAVE_MARIADB
+    else if (d_info.dbms_name == "mariadb")
+        dut_mariadb::server_profile_args(d_info.server_profile, args);
+#endif
+
+    ofstream profile_file(path + "/" + SERVER_PROFILE_FILE);
+    profile_file << "profile: " << d_info.server_profile << endl;
+    for (auto &arg : args)
+        profile_file << arg << endl;
+}
+
 void user_signal(int signal)
 {
     if (signal != SIGUSR1)
@@ -209,18 +455,94 @@ void dut_reset(dbms_info &d_info)
 {
     auto dut = dut_setup(d_info);
     dut->reset();
+    schema_changed(d_info);
 }
 
 void dut_backup(dbms_info &d_info)
 {
     auto dut = dut_setup(d_info);
     dut->backup();
+
+    snapshot_dbs.erase(d_info.test_db);
+    if (d_info.snapshot_restore == false)
+        return;
+    try
+    {
+        dut->save_snapshot();
+        snapshot_dbs.insert(d_info.test_db);
+    }
+    catch (exception &e)
+    {
+        cerr << "cannot save snapshot, restore from the backup file: " << e.what() << endl;
+    }
+}
+
+// per thread, as each fuzzing loop restores its own database
+static thread_local dut_restore_stats restore_stats;
+
+thread_local function<void(dbms_info &)> datadir_restore_hook;
+
+// the server restarted, so the connections to it are gone
+static void dut_drop_connections(dbms_info &d_info)
+{
+    dut_pool_invalidate();
+    if (false)
+    {
+    }
+#ifdef HAVE_MYSQL
+    else if (d_info.dbms_name == "mysql")
+        dut_mysql::drop_lock_observer();
+#endif
+
+#ifdef HAVE_MARIADB
+    else if (d_info.dbms_name == "mariadb")
+        dut_mariadb::drop_lock_observer();
+#endif
 }
 
 void dut_reset_to_backup(dbms_info &d_info)
 {
-    auto dut = dut_setup(d_info);
-    dut->reset_to_backup();
+    auto begin_time = get_cur_time_ms();
+
+    if (d_info.datadir_restore && datadir_restore_hook)
+    {
+        datadir_restore_hook(d_info);
+        dut_drop_connections(d_info);
+        restore_stats.datadir++;
+    }
+    else
+    {
+        auto dut = dut_setup(d_info);
+        if (snapshot_dbs.count(d_info.test_db) && dut->restore_snapshot())
+            restore_stats.snapshot++;
+        else
+        {
+            dut->reset_to_backup();
+            restore_stats.dump++;
+        }
+    }
+
+    auto restore_ms = get_cur_time_ms() - begin_time;
+    restore_stats.total_ms += restore_ms;
+    restore_stats.max_ms = max(restore_stats.max_ms, restore_ms);
+}
+
+dut_restore_stats dut_restore_get_stats()
+{
+    return restore_stats;
+}
+
+void dut_restore_report()
+{
+    auto stats = dut_restore_get_stats();
+    auto restore_num = stats.snapshot + stats.dump + stats.datadir;
+    if (restore_num == 0)
+        return;
+    cerr << "restore: " << stats.snapshot << " snapshot, "
+         << stats.dump << " dump, "
+         << stats.datadir << " datadir, "
+         << stats.total_ms / restore_num << " ms avg, "
+         << stats.max_ms << " ms max" << endl;
 }
 
 void dut_get_content(dbms_info &d_info,
@@ -235,107 +557,219 @@ void dut_get_content(dbms_info &d_info,
     dut->get_content(table_names, content);
 }
 
-void interect_test(dbms_info &d_info,
-                   shared_ptr<prod> (*tmp_statement_factory)(scope *),
-                   vector<string> &rec_vec,
-                   bool need_affect)
+// Row hash of t: its values in column order, then which of them are NULL
+// (CONCAT_WS() skips NULLs). Floats are rounded as nomoalize_content() does.
+static string row_hash_expr(table &t)
+{
+    string values, nulls;
+    for (auto &c : t.columns())
+    {
+        auto type = c.type->name;
+        transform(type.begin(), type.end(), type.begin(), ::tolower);
+        bool is_float = type.find("double") != string::npos ||
+                        type.find("float") != string::npos ||
+                        type.find("real") != string::npos ||
+                        type.find("decimal") != string::npos;
+
+        values += ", " + (is_float ? "ROUND(" + c.name + ", 2)" : c.name);
+        nulls += (nulls.empty() ? "" : ", ") + ("ISNULL(" + c.name + ")");
+    }
+    // 60 bits of the md5 of each row. CONV() returns a string, whose SUM()
+    // is a DOUBLE that depends on the scan order; the SUM() of an unsigned
+    // integer is an exact DECIMAL.
+    return "CAST(CONV(SUBSTRING(MD5(CONCAT_WS('#'" + values + ", CONCAT(" + nulls +
+           "))), 1, 15), 16, 10) AS UNSIGNED)";
+}
+
+static string table_checksum_query(table &t)
+{
+    return "SELECT '" + t.ident() + "', COUNT(*), COALESCE(SUM(" + row_hash_expr(t) +
+           "), 0) FROM " + t.ident();
+}
+
+void dut_get_content_checksum(dbms_info &d_info, map<string, string> &checksum)
 {
+    checksum.clear();
     auto schema = get_schema(d_info);
-    scope scope;
-    schema->fill_scope(scope);
+    auto dut = dut_setup(d_info);
 
-    shared_ptr<prod> gen = tmp_statement_factory(&scope);
-    ostringstream s;
-    gen->out(s);
+    // one round trip for all the tables
+    string query;
+    for (auto &t : schema->tables)
+    {
+        if (t.columns().empty())
+            continue;
+        if (!query.empty())
+            query += " UNION ALL ";
+        query += table_checksum_query(t);
+    }
+    if (query.empty())
+        return;
 
-    static int try_time = 0;
+    vector<vector<string>> output;
     try
     {
-        auto dut = dut_setup(d_info);
-        auto sql = s.str() + ";";
-        int affect_num = 0;
-        dut->test(sql, NULL, &affect_num);
+        dut->test(query + ";", &output);
+    }
+    catch (exception &e)
+    {
+        // a table that cannot be read is left out, as dut->get_content() does
+        output.clear();
+        for (auto &t : schema->tables)
+        {
+            if (t.columns().empty())
+                continue;
+            vector<vector<string>> table_output;
+            try
+            {
+                dut->test(table_checksum_query(t) + ";", &table_output);
+            }
+            catch (exception &e)
+            {
+                cerr << "Cannot get checksum of " + t.ident() + ": " << e.what() << endl;
+                continue;
+            }
+            output.insert(output.end(), table_output.begin(), table_output.end());
+        }
+    }
 
-        if (need_affect && affect_num <= 0)
-            throw runtime_error(string("affect result empty"));
+    for (auto &row : output)
+    {
+        if (row.size() < 3)
+            continue;
+        checksum[row[0]] = row[1] + ":" + row[2];
+    }
+}
 
-        rec_vec.push_back(sql);
+// Applies a DDL statement run by generate_database() to db_schema, as if it
+// were loaded again. Returns false for the statements whose effect it cannot
+// tell, e.g. the columns of a view, which are read from the server instead.
+static bool apply_ddl_to_schema(schema &db_schema, prod *ddl)
+{
+    if (auto create = dynamic_cast<create_table_stmt *>(ddl))
+    {
+        db_schema.add_table(*create->created_table);
+        return true;
+    }
+    if (auto index = dynamic_cast<create_index_stmt *>(ddl))
+    {
+        // the schema only lists the non-unique indexes
+        if (!index->is_unique)
+            db_schema.add_index(index->index_name);
+        return true;
     }
-    catch (std::exception &e)
-    { // ignore runtime error
-        string err = e.what();
-        cerr << "err: " << e.what() << endl;
-        if (err.find("syntax") != string::npos)
+    return false;
+}
+
+// Runs a DDL statement, generated again until the server accepts one.
+static void generate_ddl(dbms_info &d_info, shared_ptr<dut_base> &dut, shared_ptr<schema> &db_schema)
+{
+    int try_time = 0;
+    while (1)
+    {
+        scope scope;
+        db_schema->fill_scope(scope);
+        auto gen = ddl_statement_factory(&scope);
+        ostringstream s;
+        gen->out(s);
+
+        try
         {
-            cerr << "\n"
-                 << e.what() << "\n"
-                 << endl;
-            cerr << s.str() << endl;
+            dut->test(s.str() + ";");
+            // db_schema is the cached schema, which stays valid when the
+            // statement can be applied to it
+            if (!apply_ddl_to_schema(*db_schema, gen.get()))
+            {
+                schema_changed(d_info);
+                db_schema = get_schema(d_info);
+            }
+            return;
         }
-        if (try_time >= 128)
-        {
-            cerr << "Fail in interect_test() " << try_time << " times, return" << endl;
-            throw e;
+        catch (std::exception &e)
+        { // ignore runtime error
+            string err = e.what();
+            cerr << "err: " << err << endl;
+            if (err.find("syntax") != string::npos)
+                cerr << s.str() << endl;
+            if (++try_time >= 128)
+            {
+                cerr << "Fail in generate_ddl() " << try_time << " times, return" << endl;
+                throw;
+            }
         }
-        try_time++;
-        interect_test(d_info, tmp_statement_factory, rec_vec, need_affect);
-        try_time--;
     }
 }
 
-void normal_test(dbms_info &d_info,
-                 shared_ptr<schema> &schema,
-                 shared_ptr<prod> (*tmp_statement_factory)(scope *),
-                 vector<string> &rec_vec,
-                 bool need_affect)
+static string generate_insert(shared_ptr<schema> &db_schema)
 {
     scope scope;
-    schema->fill_scope(scope);
-
-    shared_ptr<prod> gen = tmp_statement_factory(&scope);
+    db_schema->fill_scope(scope);
+    auto gen = basic_dml_statement_factory(&scope);
     ostringstream s;
     gen->out(s);
+    return s.str() + ";";
+}
 
-    static int try_time = 0;
-    try
-    {
-        auto dut = dut_setup(d_info);
-        auto sql = s.str() + ";";
-        int affect_num = 0;
-        dut->test(sql, NULL, &affect_num);
-
-        if (need_affect && affect_num <= 0)
-            throw runtime_error(string("affect result empty"));
-        // cerr << sql.substr(0, sql.size() > 10 ? 10 : sql.size()) << " affect: " << affect_num << endl;
-        rec_vec.push_back(sql);
-    }
-    catch (std::exception &e)
-    { // ignore runtime error
-        string err = e.what();
-        if (err.find("syntax") != string::npos)
-        {
-            cerr << "trigger a syntax problem: " << err << endl;
-            cerr << "sql: " << s.str();
-        }
-
-        if (err.find("timeout") != string::npos)
-            cerr << "time out in normal test: " << err << endl;
+/**
+ * Inserts the rows of a new database: stmt_num inserts are generated up
+ * front, and run in one transaction sent as a single batch where the dut
+ * supports it. An insert that fails or inserts nothing is replaced by a new
+ * one, and the rest of the batch is sent again.
+ */
+static void load_rows(shared_ptr<dut_base> &dut, shared_ptr<schema> &db_schema, int stmt_num)
+{
+    vector<string> inserts;
+    for (int i = 0; i < stmt_num; i++)
+        inserts.push_back(generate_insert(db_schema));
 
-        if (err.find("BUG") != string::npos)
+    dut->test(dut->begin_stmt() + ";");
+    int try_time = 0;
+    size_t next = 0;
+    while (next < inserts.size())
+    {
+        vector<string> batch_tail(inserts.begin() + next + 1, inserts.end());
+        dut->pipeline(inserts[next], batch_tail);
+        while (next < inserts.size())
         {
-            cerr << "BUG is triggered in normal_test: " << err << endl;
-            throw e;
-        }
+            int affect_num = 0;
+            bool failed = false;
+            try
+            {
+                dut->test(inserts[next], NULL, &affect_num);
+            }
+            catch (std::exception &e)
+            { // ignore runtime error
+                string err = e.what();
+                if (err.find("BUG") != string::npos)
+                {
+                    cerr << "BUG is triggered in load_rows: " << err << endl;
+                    throw;
+                }
+                cerr << "err: " << err << endl;
+                failed = true;
+            }
+            if (!failed && affect_num > 0)
+            {
+                next++;
+                continue;
+            }
 
-        if (try_time >= 128)
-        {
-            cerr << "Fail in normal_test() " << try_time << " times, return" << endl;
-            throw e;
+            if (++try_time >= 128)
+            {
+                cerr << "Fail in load_rows() " << try_time << " times, return" << endl;
+                throw runtime_error(string("cannot load rows"));
+            }
+            if (failed)
+            { // the server skipped the rest of the batch, send it again
+                inserts[next] = generate_insert(db_schema);
+                break;
+            }
+            // the rest of the batch still runs, so a new insert goes last
+            inserts.erase(inserts.begin() + next);
+            inserts.push_back(generate_insert(db_schema));
         }
-        try_time++;
-        normal_test(d_info, schema, tmp_statement_factory, rec_vec, need_affect);
-        try_time--;
     }
+    dut->test(dut->commit_stmt() + ";");
 }
 
 static size_t BKDRHash(const char *str, size_t hash)
@@ -497,6 +931,34 @@ bool compare_content(map<string, vector<vector<string>>> &a_content,
     return true;
 }
 
+bool compare_content_checksum(map<string, string> &a_checksum,
+                              map<string, string> &b_checksum)
+{
+    if (a_checksum.size() != b_checksum.size())
+    {
+        cerr << "size not equal: " << a_checksum.size() << " " << b_checksum.size() << endl;
+        return false;
+    }
+
+    bool equal = true;
+    for (auto &[table, checksum] : a_checksum)
+    {
+        auto iter = b_checksum.find(table);
+        if (iter == b_checksum.end())
+        {
+            cerr << "b_checksum does not have " << table << endl;
+            return false;
+        }
+        if (iter->second != checksum)
+        {
+            cerr << "table " + table + " checksums are not equal (rows:sum): "
+                 << checksum << " " << iter->second << endl;
+            equal = false;
+        }
+    }
+    return equal;
+}
+
 bool compare_output(vector<vector<vector<string>>> &a_output,
                     vector<vector<vector<string>>> &b_output)
 {
@@ -541,25 +1003,31 @@ bool compare_output(vector<vector<vector<string>>> &a_output,
     return true;
 }
 
+/**
+ * Generates the database: the schema is built in memory as the DDL
+ * statements run, and read from the server only after those it cannot
+ * model, then the rows are inserted in one transaction.
+ */
 int generate_database(dbms_info &d_info)
 {
-    vector<string> stage_1_rec;
-    vector<string> stage_2_rec;
-
+    auto begin_time = get_cur_time_ms();
     cerr << "generating database ... ";
     dut_reset(d_info);
 
+    auto dut = dut_setup(d_info);
+    auto schema = get_schema(d_info);
     auto ddl_stmt_num = d6() + 1; // at least 2 statements to create 2 tables
     for (auto i = 0; i < ddl_stmt_num; i++)
-        interect_test(d_info, &ddl_statement_factory, stage_1_rec, false); // has disabled the not null, check and unique clause
+        generate_ddl(d_info, dut, schema); // has disabled the not null, check and unique clause
+    auto ddl_ms = get_cur_time_ms() - begin_time;
 
     auto basic_dml_stmt_num = 10 + d6(); // 11-20 statements to insert data
-    auto schema = get_schema(d_info);    // schema will not change in this stage
-    for (auto i = 0; i < basic_dml_stmt_num; i++)
-        normal_test(d_info, schema, &basic_dml_statement_factory, stage_2_rec, true);
+    load_rows(dut, schema, basic_dml_stmt_num);
+    dut = NULL;
 
     dut_backup(d_info);
-    cerr << "done" << endl;
+    cerr << "done in " << get_cur_time_ms() - begin_time << " ms ("
+         << ddl_ms << " ms schema)" << endl;
     return 0;
 }
 
@@ -628,7 +1096,7 @@ void gen_stmts_for_one_txn(shared_ptr<schema> &db_schema,
                 {
 
                     cerr << err << endl;
-                    ofstream bug_file(NORMAL_BUG_FILE);
+                    ofstream bug_file(normal_bug_file(d_info));
                     for (auto &stmt : all_tested_stmts)
                         bug_file << print_stmt_to_string(stmt) << "\n"
                                  << endl;
@@ -864,7 +1332,6 @@ bool minimize_testcase(dbms_info &d_info,
 
     // stmt level minimize
     auto stmt_num = final_tid_queue.size();
-    auto dut = dut_setup(d_info);
     for (int i = 0; i < stmt_num; i++)
     {
         cerr << "Try to delete stmt " << i << "..." << endl;
@@ -874,13 +1341,11 @@ bool minimize_testcase(dbms_info &d_info,
         vector<stmt_usage> tmp_usage_queue = final_usage_queue;
         auto tmp_stmt_num = stmt_num;
 
-        // do not delete commit or abort
-        auto tmp_stmt_str = print_stmt_to_string(tmp_stmt_queue[i]);
-        if (tmp_stmt_str.find(dut->begin_stmt()) != string::npos)
-            continue;
-        if (tmp_stmt_str.find(dut->commit_stmt()) != string::npos)
-            continue;
-        if (tmp_stmt_str.find(dut->abort_stmt()) != string::npos)
+        // do not delete begin, commit or abort
+        auto tmp_stmt_kind = render_stmt(tmp_stmt_queue[i])->kind;
+        if (tmp_stmt_kind == KIND_BEGIN ||
+            tmp_stmt_kind == KIND_COMMIT ||
+            tmp_stmt_kind == KIND_ABORT)
             continue;
 
         // do not delete instrumented stmts
@@ -1091,8 +1556,7 @@ bool reproduce_routine(dbms_info &d_info,
             continue;
         }
 
-        auto stmt_str = print_stmt_to_string(re_test.trans_arr[tid].stmts.back());
-        if (stmt_str.find("COMMIT") != string::npos)
+        if (render_stmt(re_test.trans_arr[tid].stmts.back())->kind == KIND_COMMIT)
             re_test.trans_arr[tid].status = TXN_COMMIT;
         else
             re_test.trans_arr[tid].status = TXN_ABORT;
@@ -1185,8 +1649,7 @@ bool check_txn_cycle(dbms_info &d_info,
             continue;
         }
 
-        auto stmt_str = print_stmt_to_string(re_test.trans_arr[tid].stmts.back());
-        if (stmt_str.find("COMMIT") != string::npos)
+        if (render_stmt(re_test.trans_arr[tid].stmts.back())->kind == KIND_COMMIT)
             re_test.trans_arr[tid].status = TXN_COMMIT;
         else
             re_test.trans_arr[tid].status = TXN_ABORT;
@@ -1231,6 +1694,7 @@ void txn_decycle_test(dbms_info &d_info,
     transaction_test::fork_if_server_closed(d_info);
 
     transaction_test re_test(d_info);
+    re_test.check_db_content = true;
     re_test.stmt_queue = stmt_queue;
     re_test.tid_queue = tid_queue;
     re_test.stmt_num = re_test.tid_queue.size();
@@ -1273,8 +1737,7 @@ void txn_decycle_test(dbms_info &d_info,
             continue;
         }
 
-        auto stmt_str = print_stmt_to_string(re_test.trans_arr[tid].stmts.back());
-        if (stmt_str.find("COMMIT") != string::npos)
+        if (render_stmt(re_test.trans_arr[tid].stmts.back())->kind == KIND_COMMIT)
             re_test.trans_arr[tid].status = TXN_COMMIT;
         else
             re_test.trans_arr[tid].status = TXN_ABORT;
@@ -1374,6 +1837,7 @@ void check_topo_sort(dbms_info &d_info,
     transaction_test::fork_if_server_closed(d_info);
 
     transaction_test re_test(d_info);
+    re_test.check_db_content = true;
     re_test.stmt_queue = stmt_queue;
     re_test.tid_queue = tid_queue;
     re_test.stmt_num = re_test.tid_queue.size();
@@ -1416,8 +1880,7 @@ void check_topo_sort(dbms_info &d_info,
             continue;
         }
 
-        auto stmt_str = print_stmt_to_string(re_test.trans_arr[tid].stmts.back());
-        if (stmt_str.find("COMMIT") != string::npos)
+        if (render_stmt(re_test.trans_arr[tid].stmts.back())->kind == KIND_COMMIT)
             re_test.trans_arr[tid].status = TXN_COMMIT;
         else
             re_test.trans_arr[tid].status = TXN_ABORT;
@@ -1460,7 +1923,5 @@ void check_topo_sort(dbms_info &d_info,
 
 string print_stmt_to_string(shared_ptr<prod> stmt)
 {
-    ostringstream stmt_stream;
-    stmt->out(stmt_stream);
-    return stmt_stream.str() + ";";
+    return render_stmt(stmt)->sql;
 }
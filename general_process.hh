@@ -8,6 +8,8 @@
 #include <dut.hh>     // for dut_base
 #include <sys/stat.h> // for mkdir
 #include <algorithm>  // for sort
+#include <atomic>     // for atomic
+#include <functional> // for function
 
 #include "config.h" // for PACKAGE_NAME
 
@@ -36,15 +38,21 @@ extern "C"
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
+#include <fcntl.h>
 }
 
 using namespace std;
 
 #define NORMAL_BUG_FILE "bug_trigger_stmt.sql"
 #define GEN_STMT_FILE "gen_stmts.sql"
+// settings of the server a bug was found on, to recheck it under others
+#define SERVER_PROFILE_FILE "server_profile.txt"
 
 #define KILL_PROC_TIME_MS 10000
+#define DUT_POOL_MAX_IDLE 32
 #define WAIT_FOR_PROC_TIME_MS 20000
+// how often a starting server is probed for readiness
+#define SERVER_PROBE_INTERVAL_MS 50
 
 #define RESET "\033[0m"
 #define BLACK "\033[30m"            /* Black */
@@ -86,21 +94,77 @@ bool compare_output(vector<vector<vector<string>>> &a_output,
 
 bool compare_content(map<string, vector<vector<string>>> &a_content,
                      map<string, vector<vector<string>>> &b_content);
+bool compare_content_checksum(map<string, string> &a_checksum,
+                              map<string, string> &b_checksum);
 
 pid_t fork_db_server(dbms_info &d_info);
 
+// The schema is cached until schema_changed() tells that DDL ran on the
+// database. Transactions never run DDL, so it is loaded once per database.
 shared_ptr<schema> get_schema(dbms_info &d_info);
+void schema_changed(dbms_info &d_info);
+
+struct schema_load_stats
+{
+    unsigned long hit = 0;  // served from the cache
+    unsigned long load = 0; // read from information_schema
+    unsigned long long total_ms = 0;
+    unsigned long long max_ms = 0;
+};
+
+schema_load_stats schema_load_get_stats();
+void schema_load_report();
+
+// dut_setup() hands out pooled connections, dut_connect() always opens a new one
 shared_ptr<dut_base> dut_setup(dbms_info &d_info);
+shared_ptr<dut_base> dut_connect(dbms_info &d_info);
+
+struct dut_pool_stats
+{
+    unsigned long hit = 0;
+    unsigned long miss = 0;
+    unsigned long discard = 0;
+};
+
+// drop the pooled connections, e.g. after the server is restarted
+void dut_pool_invalidate();
+dut_pool_stats dut_pool_get_stats();
+void dut_pool_report();
+
+// where normal_test() records the statements triggering a normal bug
+string normal_bug_file(dbms_info &d_info);
+
 int save_backup_file(string path, dbms_info &d_info);
+void save_server_profile(string path, dbms_info &d_info);
 int use_backup_file(string backup_file, dbms_info &d_info);
 
 void user_signal(int signal);
 
+struct dut_restore_stats
+{
+    unsigned long snapshot = 0; // restored from the in-server snapshot
+    unsigned long dump = 0;     // restored from the dump file
+    unsigned long datadir = 0;  // restored from the datadir snapshot
+    unsigned long long total_ms = 0;
+    unsigned long long max_ms = 0;
+};
+
+// With --datadir-restore, dut_reset_to_backup() calls it to have the server
+// restarted on the datadir snapshot, by the thread owning the server or
+// through it. Per thread, as each test process installs its own.
+extern thread_local function<void(dbms_info &)> datadir_restore_hook;
+
 void dut_reset(dbms_info &d_info);
 void dut_backup(dbms_info &d_info);
 void dut_reset_to_backup(dbms_info &d_info);
+// restores done by the calling thread
+dut_restore_stats dut_restore_get_stats();
+void dut_restore_report();
 void dut_get_content(dbms_info &d_info,
                      map<string, vector<vector<string>>> &content);
+// Order-independent checksum of each table, "<rows>:<sum of row hashes>",
+// computed by the server so that the rows do not leave it
+void dut_get_content_checksum(dbms_info &d_info, map<string, string> &checksum);
 
 int generate_database(dbms_info &d_info);
 void kill_process_with_SIGTERM(pid_t process_id);
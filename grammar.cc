@@ -3,23 +3,18 @@
 #include <algorithm>
 #include <stdexcept>
 #include <cassert>
+#include <sstream>
 
 #include "random.hh"
 #include "relmodel.hh"
 #include "grammar.hh"
 #include "schema.hh"
 #include "impedance.hh"
+#include "instrumentor.hh"
 
 using namespace std;
 
-int use_group = 2; // 0->no group, 1->use group, 2->to_be_define
-int in_update_set_list = 0;
-int in_in_clause = 0;    // 0-> not in "in" clause, 1-> in "in" clause
-int in_check_clause = 0; // 0-> not in "check" clause, 1-> in "check" clause
-set<string> update_used_column_ref;
-
-int write_op_id = 0;       // start from 10000
-static int row_id = 10000; // start from 10000
+// the flags and counters used while generating are in smith::gen_context
 
 /**
  * Moves the table `victim` from `target_tables` to `excluded_tables` if present, and from `target_t_with_c_of_type` to `excluded_t_with_c_of_type` if present.
@@ -265,11 +260,11 @@ joined_table::joined_table(prod *p) : table_ref(p)
     else
         type = "left outer";
 
-    auto tmp_group = use_group;
-    use_group = 0;
+    auto tmp_group = smith::ctx().use_group;
+    smith::ctx().use_group = 0;
     if (type == "inner" || type == "left outer")
         condition = join_cond::factory(this, *lhs, *rhs);
-    use_group = tmp_group;
+    smith::ctx().use_group = tmp_group;
 
     for (auto ref : lhs->refs)
         refs.push_back(ref);
@@ -532,36 +527,36 @@ query_spec::query_spec(prod *p,
     has_limit = false;
 
     if (txn_mode == true)
-        use_group = 0;
+        smith::ctx().use_group = 0;
 
-    if (use_group == 2)
+    if (smith::ctx().use_group == 2)
     { // confirm whether use group
         if (d6() == 1)
-            use_group = 1;
+            smith::ctx().use_group = 1;
         else
-            use_group = 0;
+            smith::ctx().use_group = 0;
     }
 
     if (lateral)
         scope->refs = s->refs;
 
-    int tmp_group = use_group; // store use_group temporarily
+    int tmp_group = smith::ctx().use_group; // store use_group temporarily
 
     // from clause can use "group by" or not.
-    use_group = 2;
+    smith::ctx().use_group = 2;
     // txn testing: need to know which rows are read, so just from a table
     from_clause = make_shared<struct from_clause>(this, txn_mode);
 
-    use_group = 0; // cannot use "group by" in "where" and "select" clause.
+    smith::ctx().use_group = 0; // cannot use "group by" in "where" and "select" clause.
     search = bool_expr::factory(this);
 
     // txn testing: need to know all info of columns so select * from table_name where
     select_list = make_shared<struct select_list>(this, &from_clause->reflist.back()->refs, pointed_type, txn_mode);
 
     set_quantifier = (d9() == 1) ? "distinct" : "";
-    use_group = tmp_group; // recover use_group
+    smith::ctx().use_group = tmp_group; // recover use_group
 
-    if (use_group == 1)
+    if (smith::ctx().use_group == 1)
     {
         group_clause = make_shared<struct group_clause>(this, this->scope, select_list, &from_clause->reflist.back()->refs);
         has_group = true;
@@ -622,7 +617,7 @@ query_spec::query_spec(prod *p, struct scope *s,
     has_window = false;
     has_order = false;
     has_limit = false;
-    use_group = 0;
+    smith::ctx().use_group = 0;
 
     from_clause = make_shared<struct from_clause>(this, from_table);
     search = where_search;
@@ -641,7 +636,7 @@ query_spec::query_spec(prod *p, struct scope *s,
     has_window = false;
     has_order = false;
     has_limit = false;
-    use_group = 0;
+    smith::ctx().use_group = 0;
 
     from_clause = make_shared<struct from_clause>(this, from_table);
     search = make_shared<struct comparison_op>(this, target_op, left_operand, right_operand);
@@ -676,7 +671,7 @@ delete_stmt::delete_stmt(prod *p, struct scope *s, table *v)
     : modifying_stmt(p, s, v)
 {
     scope->refs.push_back(victim);
-    write_op_id++;
+    smith::ctx().write_op_id++;
 
     // dont select the target table
     vector<named_relation *> excluded_tables;
@@ -705,7 +700,7 @@ insert_stmt::insert_stmt(prod *p, struct scope *s, table *v, bool only_const)
     : modifying_stmt(p, s, v)
 {
     match();
-    write_op_id++;
+    smith::ctx().write_op_id++;
 
     // dont select the target table
     vector<named_relation *> excluded_tables;
@@ -734,17 +729,17 @@ insert_stmt::insert_stmt(prod *p, struct scope *s, table *v, bool only_const)
             {
                 auto expr = make_shared<const_expr>(this, col.type);
                 assert(expr->type == col.type);
-                expr->expr = to_string(write_op_id); // use write_op_id
+                expr->expr = to_string(smith::ctx().write_op_id); // use write_op_id
                 value_exprs.push_back(expr);
                 continue;
             }
 
             if (col.name == "pkey")
             {
-                row_id += 1000;
+                smith::ctx().row_id += 1000;
                 auto expr = make_shared<const_expr>(this, col.type);
                 assert(expr->type == col.type);
-                expr->expr = to_string(row_id); // use write_op_id
+                expr->expr = to_string(smith::ctx().row_id); // use write_op_id
                 value_exprs.push_back(expr);
                 continue;
             }
@@ -811,9 +806,9 @@ void insert_stmt::out(std::ostream &out)
 
 set_list::set_list(prod *p, table *target) : prod(p)
 {
-    auto tmp_update_set = in_update_set_list;
-    in_update_set_list = 1;
-    update_used_column_ref.clear();
+    auto tmp_update_set = smith::ctx().in_update_set_list;
+    smith::ctx().in_update_set_list = 1;
+    smith::ctx().update_used_column_ref.clear();
     do
     {
         for (auto col : target->columns())
@@ -823,10 +818,10 @@ set_list::set_list(prod *p, table *target) : prod(p)
 
             if (col.name == "wkey")
             {
-                update_used_column_ref.insert(target->ident() + "." + col.name);
+                smith::ctx().update_used_column_ref.insert(target->ident() + "." + col.name);
                 auto expr = make_shared<const_expr>(this, col.type);
                 assert(expr->type == col.type);
-                expr->expr = to_string(write_op_id); // use write_op_id
+                expr->expr = to_string(smith::ctx().write_op_id); // use write_op_id
 
                 value_exprs.push_back(expr);
                 names.push_back(col.name);
@@ -840,7 +835,7 @@ set_list::set_list(prod *p, table *target) : prod(p)
             if (d6() < 4)
                 continue;
 
-            update_used_column_ref.insert(target->ident() + "." + col.name);
+            smith::ctx().update_used_column_ref.insert(target->ident() + "." + col.name);
 
             auto expr = value_expr::factory(this, col.type);
             value_exprs.push_back(expr);
@@ -848,7 +843,7 @@ set_list::set_list(prod *p, table *target) : prod(p)
             name_set.insert(col.name);
         }
     } while (names.size() < 2);
-    in_update_set_list = tmp_update_set;
+    smith::ctx().in_update_set_list = tmp_update_set;
 }
 
 void set_list::out(std::ostream &out)
@@ -868,7 +863,7 @@ update_stmt::update_stmt(prod *p, struct scope *s, table *v)
     : modifying_stmt(p, s, v)
 {
     scope->refs.push_back(victim);
-    write_op_id++;
+    smith::ctx().write_op_id++;
 
     // dont select the target table
     vector<named_relation *> excluded_tables;
@@ -1139,7 +1134,7 @@ string upper_translate(string str)
 
 string create_unique_column_name(void)
 {
-    static std::set<string> created_names;
+    auto &created_names = smith::ctx().created_column_names;
 
     std::string table_name = "c_" + random_identifier_generate();
     while (created_names.count(upper_translate(table_name)))
@@ -1153,8 +1148,8 @@ string create_unique_column_name(void)
 
 string unique_table_name(scope *s)
 {
-    static set<string> exist_table_name;
-    static bool init = false;
+    auto &exist_table_name = smith::ctx().exist_table_names;
+    auto &init = smith::ctx().exist_table_names_init;
 
     if (init == false)
     {
@@ -1175,8 +1170,8 @@ string unique_table_name(scope *s)
 
 string unique_index_name(scope *s)
 {
-    static set<string> exist_index_name;
-    static bool init = false;
+    auto &exist_index_name = smith::ctx().exist_index_names;
+    auto &init = smith::ctx().exist_index_names_init;
 
     if (init == false)
     {
@@ -1249,10 +1244,10 @@ create_table_stmt::create_table_stmt(prod *parent, struct scope *s)
         has_check = true;
         scope->refs.push_back(&(*created_table));
 
-        auto check_state = in_check_clause;
-        in_check_clause = 1;
+        auto check_state = smith::ctx().in_check_clause;
+        smith::ctx().in_check_clause = 1;
         check_expr = bool_expr::factory(this);
-        in_check_clause = check_state;
+        smith::ctx().in_check_clause = check_state;
     }
 #endif
 #endif
@@ -1392,8 +1387,8 @@ group_clause::group_clause(prod *p, struct scope *s,
     strout << *select_exprs[chosen_index];
     target_ref = strout.str();
 
-    int tmp_group = use_group;
-    use_group = 0; // cannot use aggregate function in aggregate function
+    int tmp_group = smith::ctx().use_group;
+    smith::ctx().use_group = 0; // cannot use aggregate function in aggregate function
     for (size_t i = 0; i < size; i++)
     {
         if (i == chosen_index)
@@ -1404,7 +1399,7 @@ group_clause::group_clause(prod *p, struct scope *s,
         select_exprs.insert(select_exprs.begin() + i, new_expr);
         select_columns[i].type = new_expr->type;
     }
-    use_group = tmp_group;
+    smith::ctx().use_group = tmp_group;
 
     // build having clause
     auto &idx = p->scope->schema->operators_returning_type;
@@ -1799,7 +1794,7 @@ insert_select_stmt::insert_select_stmt(prod *p, struct scope *s, table *v)
     target_subquery = make_shared<query_spec>(this, scope, false, &pointed_type);
     auto &select_exprs = target_subquery->select_list->value_exprs;
     auto wkey_expr = make_shared<const_expr>(this, select_exprs.front()->type);
-    wkey_expr->expr = to_string(write_op_id); // use write_op_id
+    wkey_expr->expr = to_string(smith::ctx().write_op_id); // use write_op_id
     select_exprs.erase(select_exprs.begin());
     select_exprs.insert(select_exprs.begin(), wkey_expr);
     select_exprs.front()->type = wkey_expr->type;
@@ -1965,7 +1960,7 @@ shared_ptr<prod> basic_dml_statement_factory(struct scope *s)
  */
 shared_ptr<prod> txn_statement_factory(struct scope *s, int choice)
 {
-    static int recur_time = 0;
+    auto &recur_time = smith::ctx().txn_factory_recur_time;
     try
     {
         s->new_stmt();
@@ -1995,4 +1990,59 @@ shared_ptr<prod> txn_statement_factory(struct scope *s, int choice)
         recur_time--;
         return ret;
     }
-}
\ No newline at end of file
+}
+
+static stmt_kind string_stmt_kind(const string &stmt)
+{
+    if (stmt == SPACE_HOLDER_STMT)
+        return KIND_SPACE_HOLDER;
+
+    // first word, upper-cased, e.g. "BEGIN TRANSACTION ISOLATION LEVEL READ COMMITTED" -> "BEGIN"
+    auto begin = stmt.find_first_not_of(" \n\t");
+    if (begin == string::npos)
+        return KIND_OTHER;
+    auto end = stmt.find_first_of(" \n\t;(", begin);
+    auto word = stmt.substr(begin, end == string::npos ? string::npos : end - begin);
+    transform(word.begin(), word.end(), word.begin(), ::toupper);
+
+    if (word == "BEGIN" || word == "START")
+        return KIND_BEGIN;
+    if (word == "COMMIT")
+        return KIND_COMMIT;
+    if (word == "ROLLBACK" || word == "ABORT")
+        return KIND_ABORT;
+    if (word == "SELECT")
+        return KIND_SELECT;
+    if (word == "INSERT")
+        return KIND_INSERT;
+    if (word == "UPDATE")
+        return KIND_UPDATE;
+    if (word == "DELETE")
+        return KIND_DELETE;
+    return KIND_OTHER;
+}
+
+shared_ptr<const rendered_stmt> render_stmt(const shared_ptr<prod> &stmt)
+{
+    if (stmt->rendered)
+        return stmt->rendered;
+
+    ostringstream stmt_stream;
+    stmt->out(stmt_stream);
+    auto sql = stmt_stream.str() + ";";
+
+    stmt_kind kind = KIND_OTHER;
+    if (auto str_s = dynamic_pointer_cast<txn_string_stmt>(stmt))
+        kind = string_stmt_kind(str_s->stmt);
+    else if (dynamic_pointer_cast<query_spec>(stmt))
+        kind = KIND_SELECT;
+    else if (dynamic_pointer_cast<insert_stmt>(stmt))
+        kind = KIND_INSERT;
+    else if (dynamic_pointer_cast<update_stmt>(stmt))
+        kind = KIND_UPDATE;
+    else if (dynamic_pointer_cast<delete_stmt>(stmt))
+        kind = KIND_DELETE;
+
+    stmt->rendered = make_shared<rendered_stmt>(sql, kind, extract_words_begin_with(sql, "t_"));
+    return stmt->rendered;
+}
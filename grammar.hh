@@ -14,6 +14,7 @@
 
 #include <set>
 using std::shared_ptr;
+using std::set;
 
 struct table_ref : prod
 {
@@ -596,6 +597,37 @@ struct txn_string_stmt : prod
     }
 };
 
+#define SPACE_HOLDER_STMT "select 1 from (select 1) as subq_0 where 0 <> 0"
+
+/// What a top-level statement does, as far as the transaction test cares
+enum stmt_kind
+{
+    KIND_BEGIN,
+    KIND_COMMIT,
+    KIND_ABORT,
+    KIND_SPACE_HOLDER,
+    KIND_SELECT,
+    KIND_INSERT,
+    KIND_UPDATE,
+    KIND_DELETE,
+    KIND_OTHER
+};
+
+/// A statement rendered to SQL once, with its kind and the tables it uses.
+struct rendered_stmt
+{
+    const string sql; // ends with ';'
+    const stmt_kind kind;
+    const set<string> tables; // t_* tables referred to
+    rendered_stmt(const string &sql_, stmt_kind kind_, const set<string> &tables_)
+        : sql(sql_), kind(kind_), tables(tables_) {}
+    bool is_txn_end() const { return kind == KIND_COMMIT || kind == KIND_ABORT; }
+};
+
+/// Renders a top-level statement.  The result is cached in the statement,
+/// so a statement must not be changed once it has been rendered.
+shared_ptr<const rendered_stmt> render_stmt(const shared_ptr<prod> &stmt);
+
 shared_ptr<prod> statement_factory(struct scope *s);
 shared_ptr<prod> ddl_statement_factory(struct scope *s);
 shared_ptr<prod> basic_dml_statement_factory(struct scope *s);
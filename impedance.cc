@@ -4,11 +4,12 @@
 
 using namespace std;
 
-static map<const char *, long> occurances_in_failed_query;
-static map<const char *, long> occurances_in_ok_query;
-static map<const char *, long> retries;
-static map<const char *, long> limited;
-static map<const char *, long> failed;
+// per thread, like the rest of the generator state (see smith::gen_context)
+static thread_local map<const char *, long> occurances_in_failed_query;
+static thread_local map<const char *, long> occurances_in_ok_query;
+static thread_local map<const char *, long> retries;
+static thread_local map<const char *, long> limited;
+static thread_local map<const char *, long> failed;
 
 impedance_visitor::impedance_visitor(map<const char *, long> &occured)
     : _occured(occured)
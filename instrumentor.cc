@@ -170,7 +170,7 @@ void instrumentor::ExtractPredicates(vector<shared_ptr<prod>> &stmt_queue)
         else if (auto str_s = dynamic_pointer_cast<txn_string_stmt>(stmt_queue[i]))
         {
             // begin, commit, abort, SELECT 1 WHERE 0 <> 0, but should not include SELECT * FROM t
-            if (print_stmt_to_string(str_s).find("SELECT * FROM") != string::npos)
+            if (render_stmt(str_s)->sql.find("SELECT * FROM") != string::npos)
                 throw runtime_error("Unexpected SELECT * FROM in txn_string_stmt");
         }
         else
@@ -239,7 +239,7 @@ void instrumentor::HandleUpdateStmt(shared_ptr<update_stmt> update_statement, in
     auto wkey_column = make_shared<column_reference>((struct prod *)0, columns[wkey_idx].type, columns[wkey_idx].name, table->name);
     // init the select
     auto after_write_select_stmt = make_shared<query_spec>((struct prod *)0, &used_scope, table, equal_op, wkey_column, wkey_value);
-    auto involved_tables = extract_words_begin_with(print_stmt_to_string(update_statement), "t_");
+    auto involved_tables = render_stmt(update_statement)->tables;
 
     if (ADD_PREDICATE_INSTRUMENTATION)
     {
@@ -306,7 +306,7 @@ void instrumentor::HandleDeleteStmt(shared_ptr<delete_stmt> delete_statement, in
                                                delete_statement->victim, delete_statement->search);
 
     /*---- version_set select (select * from t where 1=1) ---*/
-    auto involved_tables = extract_words_begin_with(print_stmt_to_string(delete_statement), "t_");
+    auto involved_tables = render_stmt(delete_statement)->tables;
     auto target_table_str = delete_statement->victim->ident();
 
     if (ADD_PREDICATE_INSTRUMENTATION)
@@ -404,7 +404,7 @@ void instrumentor::HandleInsertStmt(shared_ptr<insert_stmt> insert_statement, in
     auto wkey_column = make_shared<column_reference>((struct prod *)0, columns[wkey_idx].type, columns[wkey_idx].name, table->name);
     // init the select
     auto select_stmt = make_shared<query_spec>((struct prod *)0, &used_scope, table, equal_op, wkey_column, wkey_value);
-    auto involved_tables = extract_words_begin_with(print_stmt_to_string(insert_statement), "t_");
+    auto involved_tables = render_stmt(insert_statement)->tables;
 
     if (ADD_PREDICATE_INSTRUMENTATION)
     {
@@ -464,7 +464,7 @@ void instrumentor::HandleInsertStmt(shared_ptr<insert_stmt> insert_statement, in
 void instrumentor::HandleSelectStmt(shared_ptr<query_spec> query_stmt, int tid, int stmt_idx)
 {
     // normal select (with cte) query
-    auto involved_tables = extract_words_begin_with(print_stmt_to_string(query_stmt), "t_");
+    auto involved_tables = render_stmt(query_stmt)->tables;
 
     if (ADD_PREDICATE_INSTRUMENTATION)
     {
@@ -531,7 +531,7 @@ instrumentor::instrumentor(vector<shared_ptr<prod>> &stmt_queue,
 
         // begin, commit, abort, SELECT 1 WHERE 0 <> 0, but should not include SELECT * FROM t
         auto string_stmt = dynamic_pointer_cast<txn_string_stmt>(stmt);
-        if (string_stmt && print_stmt_to_string(string_stmt).find("SELECT * FROM") == string::npos)
+        if (string_stmt && render_stmt(string_stmt)->sql.find("SELECT * FROM") == string::npos)
         {
             final_tid_queue.push_back(tid);
             final_stmt_queue.push_back(stmt);
@@ -54,6 +54,12 @@ bool instrumentation_is_before(stmt_basic_type st);
 
 string stmt_basic_type_to_string(stmt_basic_type st);
 
+/**
+ * Words of str that start with begin_str at the beginning of a token,
+ * e.g. the tables ("t_") a statement touches.
+ */
+set<string> extract_words_begin_with(const string str, const string begin_str);
+
 /**
  * Stores the information of a statement: its type (SELECT / UPDATE / ... / BWR / VSR / AWR),
  * the table it operates on, and whether it is instrumented.
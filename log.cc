@@ -153,7 +153,7 @@ pqxx_logger::pqxx_logger(std::string target, std::string conninfo, struct schema
     gethostname(hostname, sizeof(hostname));
 
     ostringstream seed;
-    seed << smith::rng;
+    seed << smith::ctx().rng;
 
     result r = w.prepared("instance")(GITREV)(target)(hostname)(s.version)(seed.str()).exec();
 
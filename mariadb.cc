@@ -2,8 +2,13 @@
 #include <cassert>
 #include <cstring>
 #include "mariadb.hh"
+#include "backup_store.hh"
+#include "client_stmt.hh"
+#include "dbms_info.hh"
 #include <iostream>
 #include <set>
+#include <type_traits>
+#include <memory>
 
 #ifndef HAVE_BOOST_REGEX
 #include <regex>
@@ -23,22 +28,30 @@ extern "C"
 {
 #include <mysql/mysql.h>
 #include <unistd.h>
+#include <poll.h>
 }
 
 #define debug_info (string(__func__) + "(" + string(__FILE__) + ":" + to_string(__LINE__) + ")")
 
-mariadb_connection::mariadb_connection(string db, unsigned int port)
+bool mariadb_connection::connect(const char *db)
+{
+    auto socket = test_socket.empty() ? NULL : test_socket.c_str();
+    // password null: blank (empty) password field
+    return mysql_real_connect(&mysql, "localhost", "root", NULL, db, 0, socket, 0) != NULL;
+}
+
+mariadb_connection::mariadb_connection(string db, unsigned int port, const string &socket)
 {
     test_db = db;
-    // test_port = port;
+    test_port = port;
+    test_socket = socket;
 
     if (!mysql_init(&mysql))
         throw std::runtime_error(string(mysql_error(&mysql)) + "\nLocation: " + debug_info);
 
     mysql_options(&mysql, MYSQL_OPT_NONBLOCK, 0);
 
-    // password null: blank (empty) password field
-    if (mysql_real_connect(&mysql, "localhost", "root", NULL, test_db.c_str(), 0, NULL, 0))
+    if (connect(test_db.c_str()))
         return; // success
 
     string err = mysql_error(&mysql);
@@ -47,7 +60,7 @@ mariadb_connection::mariadb_connection(string db, unsigned int port)
 
     // error caused by unknown database, so create one
     std::cerr << test_db + " does not exist, use default db" << endl;
-    if (!mysql_real_connect(&mysql, "localhost", "root", NULL, NULL, 0, NULL, 0))
+    if (!connect(NULL))
         throw std::runtime_error(string(mysql_error(&mysql)) + "\nLocation: " + debug_info);
 
     std::cerr << "create database " + test_db << endl;
@@ -70,38 +83,34 @@ mariadb_connection::~mariadb_connection()
     mysql_close(&mysql);
 }
 
-schema_mariadb::schema_mariadb(string db, unsigned int port)
-    : mariadb_connection(db, port)
+schema_mariadb::schema_mariadb(string db, unsigned int port, const string &socket)
+    : mariadb_connection(db, port, socket)
 {
-    // Loading tables...;
-    string get_table_query = "SELECT DISTINCT TABLE_NAME FROM INFORMATION_SCHEMA.TABLES \
-        WHERE TABLE_SCHEMA='" +
-                             db + "' AND \
-              TABLE_TYPE='BASE TABLE' ORDER BY 1;";
-
-    if (mysql_real_query(&mysql, get_table_query.c_str(), get_table_query.size()))
+    // Loading tables, views and their columns...;
+    // one round trip for all relations: base tables by name, then views by
+    // name, each with its columns in ordinal order
+    string get_column_query = "SELECT T.TABLE_NAME, T.TABLE_TYPE, C.COLUMN_NAME, C.DATA_TYPE \
+        FROM INFORMATION_SCHEMA.TABLES T JOIN INFORMATION_SCHEMA.COLUMNS C \
+            ON C.TABLE_SCHEMA = T.TABLE_SCHEMA AND C.TABLE_NAME = T.TABLE_NAME \
+        WHERE T.TABLE_SCHEMA='" +
+                              db + "' AND \
+            T.TABLE_TYPE IN ('BASE TABLE', 'VIEW') \
+        ORDER BY T.TABLE_TYPE, T.TABLE_NAME, C.ORDINAL_POSITION;";
+
+    if (mysql_real_query(&mysql, get_column_query.c_str(), get_column_query.size()))
         throw std::runtime_error(string(mysql_error(&mysql)) + "\nLocation: " + debug_info);
 
     auto result = mysql_store_result(&mysql);
     while (auto row = mysql_fetch_row(result))
     {
-        table tab(row[0], "main", true, true);
-        tables.push_back(tab);
-    }
-    mysql_free_result(result);
-
-    // Loading views...;
-    string get_view_query = "select distinct table_name from information_schema.views \
-        where table_schema='" +
-                            db + "' order by 1;";
-    if (mysql_real_query(&mysql, get_view_query.c_str(), get_view_query.size()))
-        throw std::runtime_error(string(mysql_error(&mysql)) + "\nLocation: " + debug_info);
-
-    result = mysql_store_result(&mysql);
-    while (auto row = mysql_fetch_row(result))
-    {
-        table tab(row[0], "main", false, false);
-        tables.push_back(tab);
+        if (tables.empty() || tables.back().name != row[0])
+        {
+            bool is_base_table = string(row[1]) == "BASE TABLE";
+            table tab(row[0], "main", is_base_table, is_base_table);
+            tables.push_back(tab);
+        }
+        column c(row[2], sqltype::get(row[3]));
+        tables.back().columns().push_back(c);
     }
     mysql_free_result(result);
 
@@ -122,25 +131,6 @@ schema_mariadb::schema_mariadb(string db, unsigned int port)
     }
     mysql_free_result(result);
 
-    // Loading columns and constraints...;
-    for (auto &t : tables)
-    {
-        string get_column_query = "SELECT COLUMN_NAME, DATA_TYPE FROM INFORMATION_SCHEMA.COLUMNS \
-                WHERE TABLE_NAME='" +
-                                  t.ident() + "' AND \
-                    TABLE_SCHEMA='" +
-                                  db + "'  ORDER BY ORDINAL_POSITION;";
-        if (mysql_real_query(&mysql, get_column_query.c_str(), get_column_query.size()))
-            throw std::runtime_error(string(mysql_error(&mysql)) + "\nLocation: " + debug_info + "\nTable: " + t.ident());
-        result = mysql_store_result(&mysql);
-        while (auto row = mysql_fetch_row(result))
-        {
-            column c(row[0], sqltype::get(row[1]));
-            t.columns().push_back(c);
-        }
-        mysql_free_result(result);
-    }
-
     booltype = sqltype::get("tinyint");
     inttype = sqltype::get("int");
     realtype = sqltype::get("double");
@@ -531,17 +521,27 @@ void schema_mariadb::update_schema()
     return;
 }
 
-dut_mariadb::dut_mariadb(string db, unsigned int port)
-    : mariadb_connection(db, port)
+dut_mariadb::dut_mariadb(string db, unsigned int port, const string &socket)
+    : mariadb_connection(db, port, socket)
 {
     sent_sql = "";
     has_sent_sql = false;
     query_status = 0;
     txn_abort = false;
     thread_id = mysql_thread_id(&mysql);
+    sent_prepared = NULL;
+    storing_result = false;
+    reading_next = false;
+    draining = false;
+    multi_statements_on = false;
     block_test("SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ;");
 }
 
+dut_mariadb::~dut_mariadb()
+{
+    drop_prepared_stmts();
+}
+
 static unsigned long long get_cur_time_ms(void)
 {
     struct timeval tv;
@@ -552,23 +552,104 @@ static unsigned long long get_cur_time_ms(void)
     return (tv.tv_sec * 1000ULL) + tv.tv_usec / 1000;
 }
 
-bool dut_mariadb::check_whether_block()
+mariadb_lock_observer::mariadb_lock_observer(string db, unsigned int port, const string &socket)
+    : mariadb_connection(db, port, socket)
 {
-    dut_mariadb another_dut(test_db, 0);
-    string get_block_tid = "SELECT waiting_pid FROM sys.innodb_lock_waits;";
-    vector<string> output;
-    another_dut.block_test(get_block_tid, &output);
+    sample_time_ms = 0;
+    owner_pid = getpid();
+}
 
-    // check output
-    string tid_str = to_string(thread_id);
-    auto output_size = output.size();
-    for (int i = 0; i < output_size; i++)
+void mariadb_lock_observer::sample()
+{
+    // INNODB_TRX is much cheaper than the sys.innodb_lock_waits view
+    string get_block_tid = "SELECT r.trx_mysql_thread_id, b.trx_mysql_thread_id FROM information_schema.INNODB_TRX r \
+        LEFT JOIN information_schema.INNODB_LOCK_WAITS w ON w.requesting_trx_id = r.trx_id \
+        LEFT JOIN information_schema.INNODB_TRX b ON b.trx_id = w.blocking_trx_id \
+        WHERE r.trx_state = 'LOCK WAIT';";
+    if (mysql_real_query(&mysql, get_block_tid.c_str(), get_block_tid.size()))
     {
-        if (tid_str == output[i])
-            return true;
+        string err = mysql_error(&mysql);
+        auto result = mysql_store_result(&mysql);
+        mysql_free_result(result);
+        if (regex_match(err, e_crash))
+            throw std::runtime_error("BUG!!! " + err + " in mariadb::lock_observer");
+        throw std::runtime_error(err + " in mariadb::lock_observer");
     }
 
-    return false;
+    waiting_threads.clear();
+    auto result = mysql_store_result(&mysql);
+    if (result)
+    {
+        while (auto row = mysql_fetch_row(result))
+        {
+            if (row[0] == NULL)
+                continue;
+            auto &holders = waiting_threads[stoul(row[0])];
+            if (row[1] != NULL)
+                holders.insert(stoul(row[1]));
+        }
+    }
+    mysql_free_result(result);
+    sample_time_ms = get_cur_time_ms();
+}
+
+bool mariadb_lock_observer::is_waiting(unsigned long thread_id)
+{
+    if (get_cur_time_ms() - sample_time_ms >= MYSQL_LOCK_SAMPLE_MS)
+        sample();
+    return waiting_threads.count(thread_id) > 0;
+}
+
+void mariadb_lock_observer::lock_holders(unsigned long thread_id, set<unsigned long> &holders)
+{
+    holders.clear();
+    if (is_waiting(thread_id))
+        holders = waiting_threads[thread_id];
+}
+
+// per worker thread, see mysql.cc
+static thread_local mariadb_lock_observer *shared_lock_observer = NULL;
+
+mariadb_lock_observer *dut_mariadb::lock_observer(string db, unsigned int port, const string &socket)
+{
+    // an observer inherited through fork() shares its socket with the parent,
+    // closing it would close the parent's connection, so it is left alone
+    if (shared_lock_observer && shared_lock_observer->owner_pid != getpid())
+        shared_lock_observer = NULL;
+
+    if (shared_lock_observer &&
+        (shared_lock_observer->test_db != db || shared_lock_observer->test_socket != socket))
+    {
+        delete shared_lock_observer;
+        shared_lock_observer = NULL;
+    }
+
+    if (shared_lock_observer == NULL)
+        shared_lock_observer = new mariadb_lock_observer(db, port, socket);
+    return shared_lock_observer;
+}
+
+void dut_mariadb::drop_lock_observer()
+{
+    if (shared_lock_observer && shared_lock_observer->owner_pid == getpid())
+        delete shared_lock_observer;
+    shared_lock_observer = NULL;
+}
+
+bool dut_mariadb::check_whether_block()
+{
+    auto observer = lock_observer(test_db, test_port, test_socket);
+    try
+    {
+        return observer->is_waiting(thread_id);
+    }
+    catch (exception &e)
+    {
+        // drop the broken observer, the next check reconnects
+        delete observer;
+        shared_lock_observer = NULL;
+        throw;
+    }
 }
 
 void dut_mariadb::block_test(const std::string &stmt, std::vector<std::string> *output, int *affected_row_num)
@@ -630,7 +711,38 @@ void dut_mariadb::block_test(const std::string &stmt, std::vector<std::string> *
     return;
 }
 
-void dut_mariadb::test(const string &stmt, vector<vector<string>> *output, int *affected_row_num)
+bool dut_mariadb::is_blocked()
+{
+    return check_whether_block();
+}
+
+unsigned long dut_mariadb::session_id()
+{
+    return thread_id;
+}
+
+void dut_mariadb::lock_holders(set<unsigned long> &sessions)
+{
+    auto observer = lock_observer(test_db, test_port, test_socket);
+    try
+    {
+        observer->lock_holders(thread_id, sessions);
+    }
+    catch (exception &e)
+    {
+        // drop the broken observer, the next check reconnects
+        delete observer;
+        shared_lock_observer = NULL;
+        throw;
+    }
+}
+
+int dut_mariadb::socket_fd()
+{
+    return mysql_get_socket(&mysql);
+}
+
+bool dut_mariadb::async_test(const string &stmt, vector<vector<string>> *output, int *affected_row_num)
 {
     int err;
     if (txn_abort == true)
@@ -638,73 +750,96 @@ void dut_mariadb::test(const string &stmt, vector<vector<string>> *output, int *
         if (stmt == "COMMIT;")
             throw std::runtime_error("txn aborted, can only rollback \nLocation: " + debug_info);
         if (stmt == "ROLLBACK;")
-            return;
+            return true;
         throw std::runtime_error("txn aborted, stmt skipped \nLocation: " + debug_info);
     }
 
     if (has_sent_sql == false)
     {
-        query_status = mysql_real_query_start(&err, &mysql, stmt.c_str(), stmt.size());
+        // wait for the results of the batch before stmt, see dut_mysql::async_test()
+        if (!pipelined_sqls.empty() && pipelined_sqls.front() != stmt && !drain_pipeline())
+            return false;
+
+        if (!pipelined_sqls.empty())
+        { // sent with the statements before it
+            pipelined_sqls.pop_front();
+            reading_next = true;
+            query_status = mysql_next_result_start(&err, &mysql);
+        }
+        else
+        {
+            sent_packet = stmt;
+            if (batch_head == stmt && !batch_tail.empty() && enable_multi_statements())
+            {
+                for (auto &next_stmt : batch_tail)
+                    sent_packet += "\n" + next_stmt;
+                pipelined_sqls.assign(batch_tail.begin(), batch_tail.end());
+            }
+            reading_next = false;
+            query_status = mysql_real_query_start(&err, &mysql, sent_packet.c_str(), sent_packet.size());
+        }
+        batch_head = "";
+        batch_tail.clear();
+
         if (mysql_errno(&mysql) != 0)
         {
             string err = mysql_error(&mysql);
             has_sent_sql = false;
             sent_sql = "";
+            pipelined_sqls.clear();
+            reading_next = false;
             throw std::runtime_error("mysql_real_query_start fails, stmt skipped: " + err + "\nLocation: " + debug_info);
         }
         sent_sql = stmt;
         has_sent_sql = true;
     }
-
-    if (sent_sql != stmt)
-        throw std::runtime_error("sent sql stmt changed in " + debug_info +
-                                 "\nsent_sql: " + sent_sql +
-                                 "\nstmt: " + stmt);
-
-    auto begin_time = get_cur_time_ms();
-    while (1)
+    else
     {
-        query_status = mysql_real_query_cont(&err, &mysql, query_status);
+        if (sent_sql != stmt)
+            throw std::runtime_error("sent sql stmt changed in " + debug_info +
+                                     "\nsent_sql: " + sent_sql +
+                                     "\nstmt: " + stmt);
+
+        if (reading_next)
+            query_status = mysql_next_result_cont(&err, &mysql, query_status);
+        else
+            query_status = mysql_real_query_cont(&err, &mysql, query_status);
         if (mysql_errno(&mysql) != 0)
         {
             string err = mysql_error(&mysql);
             has_sent_sql = false;
             sent_sql = "";
+            // the server skips the rest of a batch after an error
+            pipelined_sqls.clear();
+            reading_next = false;
             auto result = mysql_store_result(&mysql);
             mysql_free_result(result);
 
             if (err.find("Commands out of sync") != string::npos)
             { // occasionally happens, retry the statement again
                 // cerr << err << ", repeat the statement again" << endl;
-                test(stmt, output, affected_row_num);
-                return;
+                return async_test(stmt, output, affected_row_num);
             }
             if (err.find("Deadlock found") != string::npos)
                 txn_abort = true;
             throw std::runtime_error("mysql_real_query_cont fails, stmt skipped: " + err + "\nLocation: " + debug_info);
         }
-        if (query_status == 0)
-            break;
-
-        auto cur_time = get_cur_time_ms();
-        if (cur_time - begin_time >= MYSQL_STMT_BLOCK_MS)
-        {
-            auto blocked = check_whether_block();
-            if (blocked == true)
-                throw std::runtime_error("blocked in " + debug_info);
-            begin_time = cur_time;
-        }
     }
 
+    if (query_status != 0)
+        return false;
+
     if (affected_row_num)
         *affected_row_num = mysql_affected_rows(&mysql);
 
     auto result = mysql_store_result(&mysql);
+    reading_next = false;
     if (mysql_errno(&mysql) != 0)
     {
         string err = mysql_error(&mysql);
         has_sent_sql = false;
         sent_sql = "";
+        pipelined_sqls.clear();
         if (err.find("Deadlock found") != string::npos)
             txn_abort = true;
         throw std::runtime_error("mysql_store_result fails, stmt skipped: " + err + "\nLocation: " + debug_info);
@@ -712,40 +847,245 @@ void dut_mariadb::test(const string &stmt, vector<vector<string>> *output, int *
 
     if (output && result)
     {
-        auto row_num = mysql_num_rows(result);
-        if (row_num == 0)
-        {
-            mysql_free_result(result);
-            has_sent_sql = false;
-            sent_sql = "";
-            return;
-        }
-
         auto column_num = mysql_num_fields(result);
+        output->reserve(output->size() + mysql_num_rows(result));
         while (auto row = mysql_fetch_row(result))
         {
-            vector<string> row_output;
+            output->emplace_back();
+            auto &row_output = output->back();
+            row_output.reserve(column_num);
             for (int i = 0; i < column_num; i++)
             {
-                string str;
                 if (row[i] == NULL)
-                    str = "NULL";
+                    row_output.emplace_back("NULL");
                 else
-                    str = row[i];
-                row_output.push_back(str);
+                    row_output.emplace_back(row[i]);
             }
-            output->push_back(row_output);
         }
     }
     mysql_free_result(result);
 
     has_sent_sql = false;
     sent_sql = "";
-    return;
+    return true;
+}
+
+// Returns the prepared statement of stmt (a shape, or an exact statement) on
+// this connection, and prepares it on first use. NULL if it has to go through
+// the text protocol.
+MYSQL_STMT *dut_mariadb::prepared_stmt(const string &stmt)
+{
+    auto iter = prepared_stmts.find(stmt);
+    if (iter != prepared_stmts.end())
+        return iter->second;
+
+    if (prepared_stmts.size() >= MARIADB_MAX_PREPARED_STMTS)
+        drop_prepared_stmts();
+
+    auto st = mysql_stmt_init(&mysql);
+    if (st != NULL &&
+        (mysql_stmt_prepare(st, stmt.c_str(), stmt.size()) != 0 ||
+         binary_result_is_exact(st) == false))
+    {
+        mysql_stmt_close(st);
+        st = NULL;
+    }
+    prepared_stmts[stmt] = st;
+    return st;
+}
+
+void dut_mariadb::drop_prepared_stmts()
+{
+    for (auto &[stmt, st] : prepared_stmts)
+    {
+        if (st != NULL)
+            mysql_stmt_close(st);
+    }
+    prepared_stmts.clear();
+    sent_prepared = NULL;
+}
+
+bool dut_mariadb::async_test_prepared(const string &stmt, vector<vector<string>> *output, int *affected_row_num)
+{
+    int err = 0;
+    if (has_sent_sql == false)
+    {
+        // the text protocol path knows what to do with an aborted txn,
+        // and reads the results of a batch in order
+        if (txn_abort == true || !pipelined_sqls.empty() || batch_head == stmt)
+            return async_test(stmt, output, affected_row_num);
+
+        // statements differing only in their predicate literals share one
+        // prepared statement; a shape that does not prepare (e.g. a literal
+        // that is part of a type) falls back to the exact statement
+        auto st = prepared_stmt(stmt_shape(stmt, sent_params));
+        if (st == NULL && !sent_params.empty())
+        {
+            sent_params.clear();
+            st = prepared_stmt(stmt);
+        }
+        if (st == NULL || !bind_stmt_params(st, sent_params, sent_binds))
+            return async_test(stmt, output, affected_row_num);
+
+        sent_prepared = st;
+        storing_result = false;
+        sent_sql = stmt;
+        has_sent_sql = true;
+        query_status = mysql_stmt_execute_start(&err, st);
+    }
+    else
+    {
+        if (sent_prepared == NULL) // sent through the text protocol
+            return async_test(stmt, output, affected_row_num);
+
+        if (sent_sql != stmt)
+            throw std::runtime_error("sent sql stmt changed in " + debug_info +
+                                     "\nsent_sql: " + sent_sql +
+                                     "\nstmt: " + stmt);
+
+        if (storing_result)
+            query_status = mysql_stmt_store_result_cont(&err, sent_prepared, query_status);
+        else
+            query_status = mysql_stmt_execute_cont(&err, sent_prepared, query_status);
+    }
+
+    auto st = sent_prepared;
+    while (query_status == 0 && err == 0 && storing_result == false)
+    {
+        storing_result = true;
+        query_status = mysql_stmt_store_result_start(&err, st);
+    }
+    if (query_status != 0)
+        return false;
+
+    has_sent_sql = false;
+    sent_sql = "";
+    sent_prepared = NULL;
+    if (err != 0)
+    {
+        string err_msg = mysql_stmt_error(st);
+        mysql_stmt_free_result(st);
+        if (regex_match(err_msg, e_crash))
+            throw std::runtime_error("BUG!!! " + err_msg + " in mysql::test");
+        if (err_msg.find("Deadlock found") != string::npos)
+            txn_abort = true;
+        throw std::runtime_error("mysql_stmt_execute fails, stmt skipped: " + err_msg + "\nLocation: " + debug_info);
+    }
+
+    if (affected_row_num)
+        *affected_row_num = mysql_stmt_affected_rows(st);
+
+    try
+    {
+        fetch_stmt_result(st, output);
+    }
+    catch (...)
+    {
+        mysql_stmt_free_result(st);
+        throw;
+    }
+    mysql_stmt_free_result(st);
+    return true;
+}
+
+void dut_mariadb::test(const string &stmt, vector<vector<string>> *output, int *affected_row_num)
+{
+    auto begin_time = get_cur_time_ms();
+    while (async_test(stmt, output, affected_row_num) == false)
+    {
+        // sleep on the socket until the client library can make progress
+        auto cur_time = get_cur_time_ms();
+        if (cur_time - begin_time < MYSQL_STMT_BLOCK_MS)
+        {
+            struct pollfd pfd;
+            pfd.fd = socket_fd();
+            pfd.events = 0;
+            if (query_status & MYSQL_WAIT_READ)
+                pfd.events |= POLLIN;
+            if (query_status & MYSQL_WAIT_WRITE)
+                pfd.events |= POLLOUT;
+            if (query_status & MYSQL_WAIT_EXCEPT)
+                pfd.events |= POLLPRI;
+            poll(&pfd, 1, MYSQL_STMT_BLOCK_MS - (cur_time - begin_time));
+            continue;
+        }
+
+        auto blocked = check_whether_block();
+        if (blocked == true)
+            throw std::runtime_error("blocked in " + debug_info);
+        begin_time = cur_time;
+    }
+}
+
+void dut_mariadb::pipeline(const string &stmt, const vector<string> &next_stmts)
+{
+    batch_head = stmt;
+    batch_tail = next_stmts;
+}
+
+bool dut_mariadb::enable_multi_statements()
+{
+    if (multi_statements_on == false)
+        multi_statements_on = (mysql_set_server_option(&mysql, MYSQL_OPTION_MULTI_STATEMENTS_ON) == 0);
+    return multi_statements_on;
+}
+
+// Reads and drops the results of the pipelined statements. Only happens if
+// the scheduler runs something else on the connection before them.
+// Returns false while they are still running, without blocking.
+bool dut_mariadb::drain_pipeline()
+{
+    int err = 0;
+    while (true)
+    {
+        if (draining)
+            query_status = mysql_next_result_cont(&err, &mysql, query_status);
+        else
+        {
+            if (!mysql_more_results(&mysql))
+                break;
+            query_status = mysql_next_result_start(&err, &mysql);
+            draining = true;
+        }
+        if (query_status != 0)
+            return false;
+
+        draining = false;
+        if (err != 0)
+            break; // no more results, or the server skipped the rest of the batch
+        auto result = mysql_store_result(&mysql);
+        mysql_free_result(result);
+    }
+    pipelined_sqls.clear();
+    return true;
+}
+
+bool dut_mariadb::reset_session()
+{
+    // a statement still in flight cannot be taken back
+    if (has_sent_sql || !pipelined_sqls.empty())
+        return false;
+
+    // COM_RESET_CONNECTION would also drop the session isolation level,
+    // and the generated statements never change other session state
+    try
+    {
+        block_test("ROLLBACK;");
+    }
+    catch (exception &e)
+    {
+        return false;
+    }
+
+    txn_abort = false;
+    return true;
 }
 
 void dut_mariadb::reset(void)
 {
+    // the tables are recreated, maybe with other columns
+    drop_prepared_stmts();
+
     string drop_sql = "drop database if exists " + test_db + "; ";
     if (mysql_real_query(&mysql, drop_sql.c_str(), drop_sql.size()))
     {
@@ -776,25 +1116,30 @@ void dut_mariadb::reset(void)
 
 void dut_mariadb::backup(void)
 {
-    string mysql_dump = "mysqldump -u root " + test_db + " > /tmp/mysql_bk.sql";
-    int ret = system(mysql_dump.c_str());
-    if (ret != 0)
-    {
-        std::cerr << "backup fail \nLocation: " + debug_info << endl;
-        throw std::runtime_error("backup fail \nLocation: " + debug_info);
-    }
+    backup_capture(*this, test_db, backup_file_path("mariadb", test_db, test_port));
 }
 
 void dut_mariadb::reset_to_backup(void)
 {
     reset();
-    string bk_file = "/tmp/mysql_bk.sql";
+    auto bk_file = backup_file_path("mariadb", test_db, test_port);
+    auto bk_stmts = backup_load(bk_file);
+    if (bk_stmts)
+    {
+        for (auto &stmt : *bk_stmts)
+            test(stmt);
+        return;
+    }
     if (access(bk_file.c_str(), F_OK) == -1)
         return;
 
+    // not written by backup(), e.g. the mysqldump file of an older bug report
     mysql_close(&mysql);
 
-    string mysql_source = "mysql -u root -D " + test_db + " < /tmp/mysql_bk.sql";
+    string mysql_source = "mysql -u root -D " + test_db;
+    if (!test_socket.empty())
+        mysql_source += " --socket=" + test_socket;
+    mysql_source += " < " + bk_file;
     if (system(mysql_source.c_str()) == -1)
         throw std::runtime_error(string("system() error, return -1") + "\nLocation: " + debug_info);
 
@@ -803,19 +1148,37 @@ void dut_mariadb::reset_to_backup(void)
 
     mysql_options(&mysql, MYSQL_OPT_NONBLOCK, 0);
 
-    if (!mysql_real_connect(&mysql, "localhost", "root", NULL, test_db.c_str(), 0, NULL, 0))
+    if (!connect(test_db.c_str()))
         throw std::runtime_error(string(mysql_error(&mysql)) + "\nLocation: " + debug_info);
+    thread_id = mysql_thread_id(&mysql);
+    has_sent_sql = false;
+    sent_sql = "";
+    pipelined_sqls.clear();
+    reading_next = false;
+    draining = false;
+    multi_statements_on = false;
+    block_test("SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ;");
+}
+
+void dut_mariadb::save_snapshot()
+{
+    snapshot_save(*this, test_db);
+}
+
+bool dut_mariadb::restore_snapshot()
+{
+    return snapshot_restore(*this, test_db, "TRUNCATE TABLE");
 }
 
-int dut_mariadb::save_backup_file(string path)
+int dut_mariadb::save_backup_file(string path, string db, unsigned int port)
 {
-    string cp_cmd = "cp /tmp/mysql_bk.sql " + path;
+    string cp_cmd = "cp " + backup_file_path("mariadb", db, port) + " " + path + "/" + BACKUP_REPORT_FILE;
     return system(cp_cmd.c_str());
 }
 
-int dut_mariadb::use_backup_file(string backup_file)
+int dut_mariadb::use_backup_file(string backup_file, string db, unsigned int port)
 {
-    string cp_cmd = "cp " + backup_file + " /tmp/mysql_bk.sql";
+    string cp_cmd = "cp " + backup_file + " " + backup_file_path("mariadb", db, port);
     return system(cp_cmd.c_str());
 }
 
@@ -874,18 +1237,48 @@ string dut_mariadb::abort_stmt()
     return "ROLLBACK";
 }
 
+void dut_mariadb::server_profile_args(const string &profile, vector<string> &args)
+{
+    if (profile != "fuzz")
+        return;
+    // no durability: a crashed server is thrown away, not recovered
+    args.push_back("--innodb-flush-log-at-trx-commit=0");
+    args.push_back("--innodb-flush-method=nosync");
+    args.push_back("--innodb-doublewrite=0");
+    args.push_back("--sync-binlog=0");
+    args.push_back("--skip-log-bin");
+    // the fuzz databases hold a few tables of a few rows each
+    args.push_back("--innodb-buffer-pool-size=64M");
+    // background work unrelated to the tests
+    args.push_back("--innodb-buffer-pool-dump-at-shutdown=0");
+    args.push_back("--innodb-buffer-pool-load-at-startup=0");
+    args.push_back("--event-scheduler=OFF");
+}
+
 #define TRY_FORK_TIME 5
-pid_t dut_mariadb::fork_db_server()
+pid_t dut_mariadb::fork_db_server(int server_id, unsigned int port, const string &profile)
 {
+    auto server_dir = managed_server_dir("mariadb", server_id, profile);
+    if (server_id >= 0 && access((server_dir + "/data").c_str(), F_OK) != 0)
+    { // first start of the instance, root gets an empty password
+        string init_cmd = "mkdir -p " + server_dir + " && chown mysql " + server_dir +
+                          " && /usr/bin/mysql_install_db --user=mysql --auth-root-authentication-method=normal --datadir=" +
+                          server_dir + "/data > /dev/null";
+        if (system(init_cmd.c_str()) != 0)
+            throw std::runtime_error("cannot initialize " + server_dir + "\nLocation: " + debug_info);
+    }
+
     pid_t child = -1;
     int try_time = 0;
     while (child < 0 && try_time < TRY_FORK_TIME)
     {
         child = fork();
         if (child < 0)
+        {
             cerr << "fork function fails " << endl;
+            sleep(3);
+        }
         try_time++;
-        sleep(3);
     }
 
     if (child < 0)
@@ -893,16 +1286,28 @@ pid_t dut_mariadb::fork_db_server()
 
     if (child == 0)
     {
-        char *server_argv[128];
-        int i = 0;
-        server_argv[i++] = (char *)"/usr/bin/mysqld_safe"; // path to mysqld_safe
-        server_argv[i++] = (char *)"--datadir=/var/lib/mysql";
-        server_argv[i++] = NULL;
-        execv(server_argv[0], server_argv);
+        vector<string> args = {"/usr/bin/mysqld_safe"}; // path to mysqld_safe
+        if (server_id < 0)
+            args.push_back("--datadir=/var/lib/mysql");
+        else
+        {
+            args.push_back("--datadir=" + server_dir + "/data");
+            args.push_back("--port=" + to_string(port));
+            args.push_back("--socket=" + server_dir + "/mysqld.sock");
+            args.push_back("--pid-file=" + server_dir + "/mysqld.pid");
+            args.push_back("--log-error=" + server_dir + "/error.log");
+        }
+        server_profile_args(profile, args);
+        vector<char *> server_argv;
+        for (auto &arg : args)
+            server_argv.push_back((char *)arg.c_str());
+        server_argv.push_back(NULL);
+        execv(server_argv[0], server_argv.data());
         cerr << "fork mysql server fail \nLocation: " + debug_info << endl;
+        _exit(1);
     }
 
-    sleep(3);
+    // not waited for, fork_if_server_closed() probes it until it answers
     cout << "server pid: " << child << endl;
     return child;
 }
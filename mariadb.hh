@@ -9,23 +9,50 @@ extern "C"
 #include "schema.hh"
 #include "relmodel.hh"
 #include "dut.hh"
+#include "stmt_shape.hh"
 
 #include <sys/time.h> // for gettimeofday
+#include <set>
+#include <deque>
 
 #define MYSQL_STMT_BLOCK_MS 100
+// a lock-wait sample younger than this is shared by all the duts asking
+#define MYSQL_LOCK_SAMPLE_MS 20
+// prepared statements kept per connection before they are all dropped
+#define MARIADB_MAX_PREPARED_STMTS 256
 
 struct mariadb_connection
 {
     MYSQL mysql;
     string test_db;
-    // unsigned int test_port;
-    mariadb_connection(string db, unsigned int port);
+    unsigned int test_port;
+    // socket of the server, the default one if empty. The connection goes
+    // through the socket, where root may log in without a password.
+    string test_socket;
+    mariadb_connection(string db, unsigned int port, const string &socket = "");
     ~mariadb_connection();
+    // (re)connects mysql to db, NULL for no default database
+    bool connect(const char *db);
+};
+
+// Samples the lock waits of the server on one long-lived connection,
+// shared by every dut_mariadb of the process (see lock_observer()).
+struct mariadb_lock_observer : mariadb_connection
+{
+    // waiting thread id -> thread ids holding the locks it waits for
+    std::map<unsigned long, std::set<unsigned long>> waiting_threads;
+    unsigned long long sample_time_ms;
+    pid_t owner_pid;
+
+    mariadb_lock_observer(string db, unsigned int port, const string &socket);
+    bool is_waiting(unsigned long thread_id);
+    void lock_holders(unsigned long thread_id, std::set<unsigned long> &holders);
+    void sample();
 };
 
 struct schema_mariadb : schema, mariadb_connection
 {
-    schema_mariadb(string db, unsigned int port);
+    schema_mariadb(string db, unsigned int port, const string &socket = "");
     virtual void update_schema();
     virtual std::string quote_name(const std::string &id)
     {
@@ -36,29 +63,74 @@ struct schema_mariadb : schema, mariadb_connection
 struct dut_mariadb : dut_base, mariadb_connection
 {
     virtual void test(const string &stmt, vector<vector<string>> *output = NULL, int *affected_row_num = NULL);
+    virtual bool async_test(const string &stmt, vector<vector<string>> *output = NULL, int *affected_row_num = NULL);
+    virtual bool async_test_prepared(const string &stmt, vector<vector<string>> *output = NULL, int *affected_row_num = NULL);
+    virtual void pipeline(const string &stmt, const vector<string> &next_stmts);
+    virtual int socket_fd();
+    virtual bool is_blocked();
+    virtual unsigned long session_id();
+    virtual void lock_holders(set<unsigned long> &sessions);
     virtual void reset(void);
+    virtual bool reset_session();
 
     virtual void backup(void);
     virtual void reset_to_backup(void);
-    static int save_backup_file(string path);
-    static int use_backup_file(string backup_file);
+    virtual void save_snapshot();
+    virtual bool restore_snapshot();
+    static int save_backup_file(string path, string db, unsigned int port);
+    static int use_backup_file(string backup_file, string db, unsigned int port);
 
     virtual string commit_stmt();
     virtual string abort_stmt();
     virtual string begin_stmt();
 
-    static pid_t fork_db_server();
+    // server_id >= 0 forks a managed instance listening on port, see
+    // managed_server_dir()
+    static pid_t fork_db_server(int server_id = -1, unsigned int port = 0, const string &profile = "default");
+    // server options of profile, see dbms_info::server_profile
+    static void server_profile_args(const string &profile, vector<string> &args);
+
 
     virtual void get_content(vector<string> &tables_name, map<string, vector<vector<string>>> &content);
-    dut_mariadb(string db, unsigned int port);
+    dut_mariadb(string db, unsigned int port, const string &socket = "");
+    ~dut_mariadb();
 
     void block_test(const std::string &stmt, std::vector<std::string> *output = NULL, int *affected_row_num = NULL);
     bool check_whether_block();
+    static mariadb_lock_observer *lock_observer(string db, unsigned int port, const string &socket);
+    // after a server restart, the connection of the observer is gone
+    static void drop_lock_observer();
     bool has_sent_sql;
     int query_status;
     string sent_sql;
     bool txn_abort;
     unsigned long thread_id;
+
+    // what was sent for sent_sql: the statement itself, or a batch starting with it
+    string sent_packet;
+    // statements sent after sent_sql in the same batch, whose results are not read yet
+    deque<string> pipelined_sqls;
+    // sent_sql was pipelined, and its result is read with next_result
+    bool reading_next;
+    // batch announced by pipeline() for the next statement sent
+    string batch_head;
+    vector<string> batch_tail;
+    bool multi_statements_on;
+    bool enable_multi_statements();
+    // the results of pipelined_sqls are being read and dropped
+    bool draining;
+    bool drain_pipeline();
+
+    MYSQL_STMT *prepared_stmt(const string &stmt);
+    void drop_prepared_stmts();
+    // statements prepared on this connection, NULL if one has to use the text protocol
+    map<string, MYSQL_STMT *> prepared_stmts;
+    // the in-flight statement if it is a prepared one
+    MYSQL_STMT *sent_prepared;
+    // literals bound to sent_prepared, kept until it has finished
+    vector<stmt_param> sent_params;
+    vector<MYSQL_BIND> sent_binds;
+    bool storing_result;
 };
 
 #endif
\ No newline at end of file
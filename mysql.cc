@@ -2,6 +2,8 @@
 #include <cassert>
 #include <cstring>
 #include "mysql.hh"
+#include "backup_store.hh"
+#include "dbms_info.hh"
 #include <iostream>
 #include <set>
 
@@ -23,6 +25,7 @@ extern "C"
 {
 #include <mysql/mysql.h>
 #include <unistd.h>
+#include <poll.h>
 }
 
 #define debug_info (string(__func__) + "(" + string(__FILE__) + ":" + to_string(__LINE__) + ")")
@@ -71,35 +74,31 @@ mysql_connection::~mysql_connection()
 schema_mysql::schema_mysql(string db, unsigned int port)
     : mysql_connection(db, port)
 {
-    // Loading tables...;
-    string get_table_query = "SELECT DISTINCT TABLE_NAME FROM INFORMATION_SCHEMA.TABLES \
-        WHERE TABLE_SCHEMA='" +
-                             db + "' AND \
-              TABLE_TYPE='BASE TABLE' ORDER BY 1;";
-
-    if (mysql_real_query(&mysql, get_table_query.c_str(), get_table_query.size()))
+    // Loading tables, views and their columns...;
+    // one round trip for all relations: base tables by name, then views by
+    // name, each with its columns in ordinal order
+    string get_column_query = "SELECT T.TABLE_NAME, T.TABLE_TYPE, C.COLUMN_NAME, C.DATA_TYPE \
+        FROM INFORMATION_SCHEMA.TABLES T JOIN INFORMATION_SCHEMA.COLUMNS C \
+            ON C.TABLE_SCHEMA = T.TABLE_SCHEMA AND C.TABLE_NAME = T.TABLE_NAME \
+        WHERE T.TABLE_SCHEMA='" +
+                              db + "' AND \
+            T.TABLE_TYPE IN ('BASE TABLE', 'VIEW') \
+        ORDER BY T.TABLE_TYPE, T.TABLE_NAME, C.ORDINAL_POSITION;";
+
+    if (mysql_real_query(&mysql, get_column_query.c_str(), get_column_query.size()))
         throw std::runtime_error(string(mysql_error(&mysql)) + "\nLocation: " + debug_info);
 
     auto result = mysql_store_result(&mysql);
     while (auto row = mysql_fetch_row(result))
     {
-        table tab(row[0], "main", true, true);
-        tables.push_back(tab);
-    }
-    mysql_free_result(result);
-
-    // Loading views...;
-    string get_view_query = "select distinct table_name from information_schema.views \
-        where table_schema='" +
-                            db + "' order by 1;";
-    if (mysql_real_query(&mysql, get_view_query.c_str(), get_view_query.size()))
-        throw std::runtime_error(string(mysql_error(&mysql)) + "\nLocation: " + debug_info);
-
-    result = mysql_store_result(&mysql);
-    while (auto row = mysql_fetch_row(result))
-    {
-        table tab(row[0], "main", false, false);
-        tables.push_back(tab);
+        if (tables.empty() || tables.back().name != row[0])
+        {
+            bool is_base_table = string(row[1]) == "BASE TABLE";
+            table tab(row[0], "main", is_base_table, is_base_table);
+            tables.push_back(tab);
+        }
+        column c(row[2], sqltype::get(row[3]));
+        tables.back().columns().push_back(c);
     }
     mysql_free_result(result);
 
@@ -120,25 +119,6 @@ schema_mysql::schema_mysql(string db, unsigned int port)
     }
     mysql_free_result(result);
 
-    // Loading columns and constraints...;
-    for (auto &t : tables)
-    {
-        string get_column_query = "SELECT COLUMN_NAME, DATA_TYPE FROM INFORMATION_SCHEMA.COLUMNS \
-                WHERE TABLE_NAME='" +
-                                  t.ident() + "' AND \
-                    TABLE_SCHEMA='" +
-                                  db + "'  ORDER BY ORDINAL_POSITION;";
-        if (mysql_real_query(&mysql, get_column_query.c_str(), get_column_query.size()))
-            throw std::runtime_error(string(mysql_error(&mysql)) + "\nLocation: " + debug_info + "\nTable: " + t.ident());
-        result = mysql_store_result(&mysql);
-        while (auto row = mysql_fetch_row(result))
-        {
-            column c(row[0], sqltype::get(row[1]));
-            t.columns().push_back(c);
-        }
-        mysql_free_result(result);
-    }
-
     booltype = sqltype::get("tinyint");
     inttype = sqltype::get("int");
     realtype = sqltype::get("double");
@@ -533,6 +513,8 @@ dut_mysql::dut_mysql(string db, unsigned int port)
     has_sent_sql = false;
     txn_abort = false;
     thread_id = mysql_thread_id(&mysql);
+    reading_next = false;
+    multi_statements_on = false;
     block_test("SET GLOBAL TRANSACTION ISOLATION LEVEL SERIALIZABLE;");
 }
 
@@ -546,23 +528,107 @@ static unsigned long long get_cur_time_ms(void)
     return (tv.tv_sec * 1000ULL) + tv.tv_usec / 1000;
 }
 
-bool dut_mysql::check_whether_block()
+mysql_lock_observer::mysql_lock_observer(string db, unsigned int port)
+    : mysql_connection(db, port)
+{
+    sample_time_ms = 0;
+    owner_pid = getpid();
+}
+
+void mysql_lock_observer::sample()
 {
-    dut_mysql another_dut(test_db, test_port);
-    string get_block_tid = "SELECT waiting_pid FROM sys.innodb_lock_waits;";
-    vector<string> output;
-    another_dut.block_test(get_block_tid, &output);
+    // INNODB_TRX is much cheaper than the sys.innodb_lock_waits view,
+    // which joins data_locks with data_lock_waits on every call.
+    // The holder is NULL if performance_schema is disabled.
+    string get_block_tid = "SELECT r.trx_mysql_thread_id, b.trx_mysql_thread_id FROM information_schema.INNODB_TRX r \
+        LEFT JOIN performance_schema.data_lock_waits w ON w.REQUESTING_ENGINE_TRANSACTION_ID = r.trx_id \
+        LEFT JOIN information_schema.INNODB_TRX b ON b.trx_id = w.BLOCKING_ENGINE_TRANSACTION_ID \
+        WHERE r.trx_state = 'LOCK WAIT';";
+    if (mysql_real_query(&mysql, get_block_tid.c_str(), get_block_tid.size()))
+    {
+        string err = mysql_error(&mysql);
+        auto result = mysql_store_result(&mysql);
+        mysql_free_result(result);
+        if (regex_match(err, e_crash))
+            throw std::runtime_error("BUG!!! " + err + " in mysql::lock_observer");
+        throw std::runtime_error(err + " in mysql::lock_observer");
+    }
 
-    // check output
-    string tid_str = to_string(thread_id);
-    auto output_size = output.size();
-    for (int i = 0; i < output_size; i++)
+    waiting_threads.clear();
+    auto result = mysql_store_result(&mysql);
+    if (result)
     {
-        if (tid_str == output[i])
-            return true;
+        while (auto row = mysql_fetch_row(result))
+        {
+            if (row[0] == NULL)
+                continue;
+            auto &holders = waiting_threads[stoul(row[0])];
+            if (row[1] != NULL)
+                holders.insert(stoul(row[1]));
+        }
+    }
+    mysql_free_result(result);
+    sample_time_ms = get_cur_time_ms();
+}
+
+bool mysql_lock_observer::is_waiting(unsigned long thread_id)
+{
+    if (get_cur_time_ms() - sample_time_ms >= MYSQL_LOCK_SAMPLE_MS)
+        sample();
+    return waiting_threads.count(thread_id) > 0;
+}
+
+void mysql_lock_observer::lock_holders(unsigned long thread_id, set<unsigned long> &holders)
+{
+    holders.clear();
+    if (is_waiting(thread_id))
+        holders = waiting_threads[thread_id];
+}
+
+// one observer per worker thread, like the dut pool: its connection is not
+// shared between threads, and each worker may test its own server
+static thread_local mysql_lock_observer *shared_lock_observer = NULL;
+
+mysql_lock_observer *dut_mysql::lock_observer(string db, unsigned int port)
+{
+    // an observer inherited through fork() shares its socket with the parent,
+    // closing it would close the parent's connection, so it is left alone
+    if (shared_lock_observer && shared_lock_observer->owner_pid != getpid())
+        shared_lock_observer = NULL;
+
+    if (shared_lock_observer &&
+        (shared_lock_observer->test_db != db || shared_lock_observer->test_port != port))
+    {
+        delete shared_lock_observer;
+        shared_lock_observer = NULL;
     }
 
-    return false;
+    if (shared_lock_observer == NULL)
+        shared_lock_observer = new mysql_lock_observer(db, port);
+    return shared_lock_observer;
+}
+
+void dut_mysql::drop_lock_observer()
+{
+    if (shared_lock_observer && shared_lock_observer->owner_pid == getpid())
+        delete shared_lock_observer;
+    shared_lock_observer = NULL;
+}
+
+bool dut_mysql::check_whether_block()
+{
+    auto observer = lock_observer(test_db, test_port);
+    try
+    {
+        return observer->is_waiting(thread_id);
+    }
+    catch (exception &e)
+    {
+        // drop the broken observer, the next check reconnects
+        delete observer;
+        shared_lock_observer = NULL;
+        throw;
+    }
 }
 
 void dut_mysql::block_test(const std::string &stmt, std::vector<std::string> *output, int *affected_row_num)
@@ -624,7 +690,38 @@ void dut_mysql::block_test(const std::string &stmt, std::vector<std::string> *ou
     return;
 }
 
-void dut_mysql::test(const string &stmt, vector<vector<string>> *output, int *affected_row_num)
+bool dut_mysql::is_blocked()
+{
+    return check_whether_block();
+}
+
+unsigned long dut_mysql::session_id()
+{
+    return thread_id;
+}
+
+void dut_mysql::lock_holders(set<unsigned long> &sessions)
+{
+    auto observer = lock_observer(test_db, test_port);
+    try
+    {
+        observer->lock_holders(thread_id, sessions);
+    }
+    catch (exception &e)
+    {
+        // drop the broken observer, the next check reconnects
+        delete observer;
+        shared_lock_observer = NULL;
+        throw;
+    }
+}
+
+int dut_mysql::socket_fd()
+{
+    return mysql.net.fd;
+}
+
+bool dut_mysql::async_test(const string &stmt, vector<vector<string>> *output, int *affected_row_num)
 {
     net_async_status status;
     if (txn_abort == true)
@@ -633,16 +730,39 @@ void dut_mysql::test(const string &stmt, vector<vector<string>> *output, int *af
         if (stmt == "COMMIT;")
             throw std::runtime_error("txn aborted, can only rollback \nLocation: " + debug_info);
         if (stmt == "ROLLBACK;")
-            return;
+            return true;
         throw std::runtime_error("txn aborted, stmt skipped \nLocation: " + debug_info);
     }
 
     if (has_sent_sql == false)
     {
-        auto clear_results = mysql_store_result(&mysql);
-        mysql_free_result(clear_results);
+        // the results before stmt are still coming, the caller waits for
+        // them like for stmt itself, and sees if they wait for a lock
+        if (!pipelined_sqls.empty() && pipelined_sqls.front() != stmt && !drain_pipeline())
+            return false;
+
+        if (!pipelined_sqls.empty())
+        { // sent with the statements before it
+            pipelined_sqls.pop_front();
+            reading_next = true;
+        }
+        else
+        {
+            auto clear_results = mysql_store_result(&mysql);
+            mysql_free_result(clear_results);
+
+            sent_packet = stmt;
+            if (batch_head == stmt && !batch_tail.empty() && enable_multi_statements())
+            {
+                for (auto &next_stmt : batch_tail)
+                    sent_packet += "\n" + next_stmt;
+                pipelined_sqls.assign(batch_tail.begin(), batch_tail.end());
+            }
+            reading_next = false;
+        }
+        batch_head = "";
+        batch_tail.clear();
 
-        status = mysql_real_query_nonblocking(&mysql, stmt.c_str(), stmt.size());
         sent_sql = stmt;
         has_sent_sql = true;
     }
@@ -652,36 +772,28 @@ void dut_mysql::test(const string &stmt, vector<vector<string>> *output, int *af
                                  "\nsent_sql: " + sent_sql +
                                  "\nstmt: " + stmt);
 
-    auto begin_time = get_cur_time_ms();
-    while (1)
-    {
-        status = mysql_real_query_nonblocking(&mysql, stmt.c_str(), stmt.size());
-        if (status != NET_ASYNC_NOT_READY)
-            break;
-
-        auto cur_time = get_cur_time_ms();
-        if (cur_time - begin_time >= MYSQL_STMT_BLOCK_MS)
-        {
-            auto blocked = check_whether_block();
-            if (blocked == true)
-                throw std::runtime_error("blocked in " + debug_info);
-            begin_time = cur_time;
-        }
-    }
+    if (reading_next)
+        status = mysql_next_result_nonblocking(&mysql);
+    else
+        status = mysql_real_query_nonblocking(&mysql, sent_packet.c_str(), sent_packet.size());
+    if (status == NET_ASYNC_NOT_READY)
+        return false;
 
     if (status == NET_ASYNC_ERROR)
     {
         string err = mysql_error(&mysql);
         has_sent_sql = false;
         sent_sql = "";
+        // the server skips the rest of a batch after an error
+        pipelined_sqls.clear();
+        reading_next = false;
         auto result = mysql_store_result(&mysql);
         mysql_free_result(result);
 
         if (err.find("Commands out of sync") != string::npos)
         { // occasionally happens, retry the statement again
             // cerr << err << ", repeat the statement again" << endl;
-            test(stmt, output, affected_row_num);
-            return;
+            return async_test(stmt, output, affected_row_num);
         }
         if (err.find("Deadlock found") != string::npos)
             txn_abort = true;
@@ -692,11 +804,13 @@ void dut_mysql::test(const string &stmt, vector<vector<string>> *output, int *af
         *affected_row_num = mysql_affected_rows(&mysql);
 
     auto result = mysql_store_result(&mysql);
+    reading_next = false;
     if (mysql_errno(&mysql) != 0)
     {
         string err = mysql_error(&mysql);
         has_sent_sql = false;
         sent_sql = "";
+        pipelined_sqls.clear();
         mysql_free_result(result);
         if (err.find("Deadlock found") != string::npos)
             txn_abort = true;
@@ -705,36 +819,98 @@ void dut_mysql::test(const string &stmt, vector<vector<string>> *output, int *af
 
     if (output && result)
     {
-        auto row_num = mysql_num_rows(result);
-        if (row_num == 0)
-        {
-            mysql_free_result(result);
-            has_sent_sql = false;
-            sent_sql = "";
-            return;
-        }
-
         auto column_num = mysql_num_fields(result);
+        output->reserve(output->size() + mysql_num_rows(result));
         while (auto row = mysql_fetch_row(result))
         {
-            vector<string> row_output;
+            output->emplace_back();
+            auto &row_output = output->back();
+            row_output.reserve(column_num);
             for (int i = 0; i < column_num; i++)
             {
-                string str;
                 if (row[i] == NULL)
-                    str = "NULL";
+                    row_output.emplace_back("NULL");
                 else
-                    str = row[i];
-                row_output.push_back(str);
+                    row_output.emplace_back(row[i]);
             }
-            output->push_back(row_output);
         }
     }
     mysql_free_result(result);
 
     has_sent_sql = false;
     sent_sql = "";
-    return;
+    return true;
+}
+
+void dut_mysql::test(const string &stmt, vector<vector<string>> *output, int *affected_row_num)
+{
+    auto begin_time = get_cur_time_ms();
+    while (async_test(stmt, output, affected_row_num) == false)
+    {
+        // sleep on the socket instead of spinning on the client library
+        auto cur_time = get_cur_time_ms();
+        if (cur_time - begin_time < MYSQL_STMT_BLOCK_MS)
+        {
+            struct pollfd pfd;
+            pfd.fd = socket_fd();
+            pfd.events = POLLIN;
+            poll(&pfd, 1, MYSQL_STMT_BLOCK_MS - (cur_time - begin_time));
+            continue;
+        }
+
+        auto blocked = check_whether_block();
+        if (blocked == true)
+            throw std::runtime_error("blocked in " + debug_info);
+        begin_time = cur_time;
+    }
+}
+
+void dut_mysql::pipeline(const string &stmt, const vector<string> &next_stmts)
+{
+    batch_head = stmt;
+    batch_tail = next_stmts;
+}
+
+bool dut_mysql::enable_multi_statements()
+{
+    if (multi_statements_on == false)
+        multi_statements_on = (mysql_set_server_option(&mysql, MYSQL_OPTION_MULTI_STATEMENTS_ON) == 0);
+    return multi_statements_on;
+}
+
+// Reads and drops the results of the pipelined statements. Only happens if
+// the scheduler runs something else on the connection before them.
+// Returns false while they are still running, without blocking.
+bool dut_mysql::drain_pipeline()
+{
+    while (mysql_more_results(&mysql))
+    {
+        auto status = mysql_next_result_nonblocking(&mysql);
+        if (status == NET_ASYNC_NOT_READY)
+            return false;
+        if (status == NET_ASYNC_ERROR)
+            break; // the server skips the rest of the batch
+        auto result = mysql_store_result(&mysql);
+        mysql_free_result(result);
+    }
+    pipelined_sqls.clear();
+    return true;
+}
+
+bool dut_mysql::reset_session()
+{
+    // a statement still in flight cannot be taken back
+    if (has_sent_sql || !pipelined_sqls.empty())
+        return false;
+
+    // rolls back the open transaction and clears the session state,
+    // the isolation level is global so it survives
+    if (mysql_reset_connection(&mysql))
+        return false;
+
+    txn_abort = false;
+    multi_statements_on = false;
+    return true;
 }
 
 void dut_mysql::reset(void)
@@ -769,41 +945,63 @@ void dut_mysql::reset(void)
 
 void dut_mysql::backup(void)
 {
-    string mysql_dump = "/usr/bin/mysqldump -h 127.0.0.1 -P " + to_string(test_port) + " -u root " + test_db + " > /tmp/mysql_bk.sql";
-    int ret = system(mysql_dump.c_str());
-    if (ret != 0)
-    {
-        std::cerr << "backup fail \nLocation: " + debug_info << endl;
-        throw std::runtime_error("backup fail \nLocation: " + debug_info);
-    }
+    backup_capture(*this, test_db, backup_file_path("mysql", test_db, test_port));
 }
 
 void dut_mysql::reset_to_backup(void)
 {
     reset();
-    string bk_file = "/tmp/mysql_bk.sql";
+    auto bk_file = backup_file_path("mysql", test_db, test_port);
+    auto bk_stmts = backup_load(bk_file);
+    if (bk_stmts)
+    {
+        for (auto &stmt : *bk_stmts)
+            test(stmt);
+        return;
+    }
     if (access(bk_file.c_str(), F_OK) == -1)
         return;
 
+    // not written by backup(), e.g. the mysqldump file of an older bug report
     mysql_close(&mysql);
 
-    string mysql_source = "/usr/bin/mysql -h 127.0.0.1 -P " + to_string(test_port) + " -u root -D " + test_db + " < /tmp/mysql_bk.sql";
+    string mysql_source = "/usr/bin/mysql -h 127.0.0.1 -P " + to_string(test_port) + " -u root -D " + test_db + " < " + bk_file;
     if (system(mysql_source.c_str()) == -1)
         throw std::runtime_error(string("system() error, return -1") + "\nLocation: " + debug_info);
 
+    // the connection is reused by the pool, so it must be fully set up again
+    if (!mysql_init(&mysql))
+        throw std::runtime_error(string(mysql_error(&mysql)) + "\nLocation: " + debug_info);
+
     if (!mysql_real_connect(&mysql, "127.0.0.1", "root", NULL, test_db.c_str(), test_port, NULL, 0))
         throw std::runtime_error(string(mysql_error(&mysql)) + "\nLocation: " + debug_info);
+    thread_id = mysql_thread_id(&mysql);
+    has_sent_sql = false;
+    sent_sql = "";
+    pipelined_sqls.clear();
+    reading_next = false;
+    multi_statements_on = false;
+}
+
+void dut_mysql::save_snapshot()
+{
+    snapshot_save(*this, test_db);
 }
 
-int dut_mysql::save_backup_file(string path)
+bool dut_mysql::restore_snapshot()
 {
-    string cp_cmd = "cp /tmp/mysql_bk.sql " + path;
+    return snapshot_restore(*this, test_db, "TRUNCATE TABLE");
+}
+
+int dut_mysql::save_backup_file(string path, string db, unsigned int port)
+{
+    string cp_cmd = "cp " + backup_file_path("mysql", db, port) + " " + path + "/" + BACKUP_REPORT_FILE;
     return system(cp_cmd.c_str());
 }
 
-int dut_mysql::use_backup_file(string backup_file)
+int dut_mysql::use_backup_file(string backup_file, string db, unsigned int port)
 {
-    string cp_cmd = "cp " + backup_file + " /tmp/mysql_bk.sql";
+    string cp_cmd = "cp " + backup_file + " " + backup_file_path("mysql", db, port);
     return system(cp_cmd.c_str());
 }
 
@@ -862,8 +1060,36 @@ string dut_mysql::abort_stmt()
     return "ROLLBACK";
 }
 
-pid_t dut_mysql::fork_db_server()
+void dut_mysql::server_profile_args(const string &profile, vector<string> &args)
 {
+    if (profile != "fuzz")
+        return;
+    // no durability: a crashed server is thrown away, not recovered
+    args.push_back("--innodb-flush-log-at-trx-commit=0");
+    args.push_back("--innodb-flush-method=nosync");
+    args.push_back("--innodb-doublewrite=OFF");
+    args.push_back("--sync-binlog=0");
+    args.push_back("--skip-log-bin");
+    // the fuzz databases hold a few tables of a few rows each
+    args.push_back("--innodb-buffer-pool-size=64M");
+    args.push_back("--innodb-buffer-pool-instances=1");
+    // background work unrelated to the tests
+    args.push_back("--innodb-buffer-pool-dump-at-shutdown=OFF");
+    args.push_back("--innodb-buffer-pool-load-at-startup=OFF");
+    args.push_back("--event-scheduler=OFF");
+}
+
+pid_t dut_mysql::fork_db_server(int server_id, unsigned int port, const string &profile)
+{
+    auto server_dir = managed_server_dir("mysql", server_id, profile);
+    if (server_id >= 0 && access((server_dir + "/data").c_str(), F_OK) != 0)
+    { // first start of the instance, root gets an empty password
+        string init_cmd = "mkdir -p " + server_dir + " && chown mysql " + server_dir +
+                          " && /usr/sbin/mysqld --initialize-insecure --user=mysql --datadir=" + server_dir + "/data";
+        if (system(init_cmd.c_str()) != 0)
+            throw std::runtime_error("cannot initialize " + server_dir + "\nLocation: " + debug_info);
+    }
+
     pid_t child = fork();
     if (child < 0)
     {
@@ -872,19 +1098,30 @@ pid_t dut_mysql::fork_db_server()
 
     if (child == 0)
     {
-        char *server_argv[] = {
-            (char *)"/usr/sbin/mysqld", // Adjust the path if necessary
-            // (char *)"--basedir=/usr",                     // Base directory for MySQL
-            // (char *)"--datadir=/var/lib/mysql",           // Data directory for MySQL
-            // (char *)"--plugin-dir=/usr/lib/mysql/plugin", // Plugin directory
-            (char *)"--user=mysql", // User to run the server
-            NULL                    // Terminate the array
+        vector<string> args = {
+            "/usr/sbin/mysqld", // Adjust the path if necessary
+            "--user=mysql",     // User to run the server
         };
-        execv(server_argv[0], server_argv);
+        if (server_id >= 0)
+        {
+            args.push_back("--datadir=" + server_dir + "/data");
+            args.push_back("--port=" + to_string(port));
+            args.push_back("--socket=" + server_dir + "/mysqld.sock");
+            args.push_back("--pid-file=" + server_dir + "/mysqld.pid");
+            args.push_back("--log-error=" + server_dir + "/error.log");
+            args.push_back("--mysqlx=OFF"); // its port would clash between the instances
+        }
+        server_profile_args(profile, args);
+        vector<char *> server_argv;
+        for (auto &arg : args)
+            server_argv.push_back((char *)arg.c_str());
+        server_argv.push_back(NULL);
+        execv(server_argv[0], server_argv.data());
         cerr << "fork mysql server fail \nLocation: " + debug_info << endl;
+        _exit(1);
     }
 
-    sleep(3);
+    // not waited for, fork_if_server_closed() probes it until it answers
     cout << "server pid: " << child << endl;
     return child;
 }
@@ -11,8 +11,12 @@ extern "C"
 #include "dut.hh"
 
 #include <sys/time.h> // for gettimeofday
+#include <set>
+#include <deque>
 
 #define MYSQL_STMT_BLOCK_MS 100
+// a lock-wait sample younger than this is shared by all the duts asking
+#define MYSQL_LOCK_SAMPLE_MS 20
 
 struct mysql_connection
 {
@@ -23,6 +27,21 @@ struct mysql_connection
     ~mysql_connection();
 };
 
+// Samples the lock waits of the server on one long-lived connection,
+// shared by every dut_mysql of the process (see lock_observer()).
+struct mysql_lock_observer : mysql_connection
+{
+    // waiting thread id -> thread ids holding the locks it waits for
+    std::map<unsigned long, std::set<unsigned long>> waiting_threads;
+    unsigned long long sample_time_ms;
+    pid_t owner_pid;
+
+    mysql_lock_observer(string db, unsigned int port);
+    bool is_waiting(unsigned long thread_id);
+    void lock_holders(unsigned long thread_id, std::set<unsigned long> &holders);
+    void sample();
+};
+
 struct schema_mysql : schema, mysql_connection
 {
     schema_mysql(string db, unsigned int port);
@@ -36,29 +55,59 @@ struct schema_mysql : schema, mysql_connection
 struct dut_mysql : dut_base, mysql_connection
 {
     virtual void test(const string &stmt, vector<vector<string>> *output = NULL, int *affected_row_num = NULL);
+    virtual bool async_test(const string &stmt, vector<vector<string>> *output = NULL, int *affected_row_num = NULL);
+    virtual void pipeline(const string &stmt, const vector<string> &next_stmts);
+    virtual int socket_fd();
+    virtual bool is_blocked();
+    virtual unsigned long session_id();
+    virtual void lock_holders(set<unsigned long> &sessions);
     virtual void reset(void);
+    virtual bool reset_session();
 
     virtual void backup(void);
     virtual void reset_to_backup(void);
+    virtual void save_snapshot();
+    virtual bool restore_snapshot();
 
     virtual string commit_stmt();
     virtual string abort_stmt();
     virtual string begin_stmt();
 
-    static pid_t fork_db_server();
+    // server_id >= 0 forks a managed instance listening on port, see
+    // managed_server_dir()
+    static pid_t fork_db_server(int server_id = -1, unsigned int port = 0, const string &profile = "default");
+    // server options of profile, see dbms_info::server_profile
+    static void server_profile_args(const string &profile, vector<string> &args);
+
 
     virtual void get_content(vector<string> &tables_name, map<string, vector<vector<string>>> &content);
     dut_mysql(string db, unsigned int port);
 
-    static int save_backup_file(string path);
-    static int use_backup_file(string backup_file);
+    static int save_backup_file(string path, string db, unsigned int port);
+    static int use_backup_file(string backup_file, string db, unsigned int port);
 
     void block_test(const std::string &stmt, std::vector<std::string> *output = NULL, int *affected_row_num = NULL);
     bool check_whether_block();
+    static mysql_lock_observer *lock_observer(string db, unsigned int port);
+    // after a server restart, the connection of the observer is gone
+    static void drop_lock_observer();
     bool has_sent_sql;
     string sent_sql;
     bool txn_abort;
     unsigned long thread_id;
+
+    // what was sent for sent_sql: the statement itself, or a batch starting with it
+    string sent_packet;
+    // statements sent after sent_sql in the same batch, whose results are not read yet
+    deque<string> pipelined_sqls;
+    // sent_sql was pipelined, and its result is read with next_result
+    bool reading_next;
+    // batch announced by pipeline() for the next statement sent
+    string batch_head;
+    vector<string> batch_tail;
+    bool multi_statements_on;
+    bool enable_multi_statements();
+    bool drain_pipeline();
 };
 
 #endif
\ No newline at end of file
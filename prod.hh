@@ -3,6 +3,7 @@
 
 #include <string>
 #include <iostream>
+#include <memory>
 
 #ifndef PROD_HH
 #define PROD_HH
@@ -11,7 +12,6 @@
 #define TEST_TIDB
 
 #define MAX_TRY_TIME 1
-#define TEST_TIME_FOR_EACH_DB 10
 #define TRANSACTION_TIMEOUT 360000 // 100 hour == no timeout
 
 /**
@@ -32,6 +32,8 @@ struct prod_visitor
 };
 
 /// Base class for AST nodes
+struct rendered_stmt;
+
 struct prod
 {
     /// Parent production that instanciated this one.  May be NULL for
@@ -47,6 +49,9 @@ struct prod
     /// Maximum number of retries allowed before reporting a failure to
     /// the Parent prod.
     long retry_limit = 100;
+    /// SQL of this statement, cached by render_stmt().  NULL until the
+    /// statement is first rendered.
+    std::shared_ptr<const struct rendered_stmt> rendered;
     prod(prod *parent);
     /// Newline and indent according to tree level.
     virtual void indent(std::ostream &out);
@@ -2,82 +2,108 @@
 
 namespace smith
 {
-    std::mt19937_64 rng;
+    static thread_local gen_context thread_context;
+    static thread_local gen_context *cur_context = NULL;
+
+    gen_context &ctx()
+    {
+        if (cur_context == NULL)
+            return thread_context;
+        return *cur_context;
+    }
+
+    context_guard::context_guard(gen_context &c)
+    {
+        prev = cur_context;
+        cur_context = &c;
+    }
+
+    context_guard::~context_guard()
+    {
+        cur_context = prev;
+    }
 }
 
 int d6()
 {
-    if (file_random_machine::using_file == NULL)
+    auto using_file = file_random_machine::using_file();
+    if (using_file == NULL)
     {
-        static std::uniform_int_distribution<> pick(1, 6);
-        return pick(smith::rng);
+        std::uniform_int_distribution<> pick(1, 6);
+        return pick(smith::ctx().rng);
     }
     else
-        return file_random_machine::using_file->get_random_num(1, 6, 1);
+        return using_file->get_random_num(1, 6, 1);
 }
 
 int d9()
 {
-    if (file_random_machine::using_file == NULL)
+    auto using_file = file_random_machine::using_file();
+    if (using_file == NULL)
     {
-        static std::uniform_int_distribution<> pick(1, 9);
-        return pick(smith::rng);
+        std::uniform_int_distribution<> pick(1, 9);
+        return pick(smith::ctx().rng);
     }
     else
-        return file_random_machine::using_file->get_random_num(1, 9, 1);
+        return using_file->get_random_num(1, 9, 1);
 }
 
 int d12()
 {
-    if (file_random_machine::using_file == NULL)
+    auto using_file = file_random_machine::using_file();
+    if (using_file == NULL)
     {
-        static std::uniform_int_distribution<> pick(1, 12);
-        return pick(smith::rng);
+        std::uniform_int_distribution<> pick(1, 12);
+        return pick(smith::ctx().rng);
     }
     else
-        return file_random_machine::using_file->get_random_num(1, 12, 1);
+        return using_file->get_random_num(1, 12, 1);
 }
 
 int d20()
 {
-    if (file_random_machine::using_file == NULL)
+    auto using_file = file_random_machine::using_file();
+    if (using_file == NULL)
     {
-        static std::uniform_int_distribution<> pick(1, 20);
-        return pick(smith::rng);
+        std::uniform_int_distribution<> pick(1, 20);
+        return pick(smith::ctx().rng);
     }
     else
-        return file_random_machine::using_file->get_random_num(1, 20, 1);
+        return using_file->get_random_num(1, 20, 1);
 }
 
 int d42()
 {
-    if (file_random_machine::using_file == NULL)
+    auto using_file = file_random_machine::using_file();
+    if (using_file == NULL)
     {
-        static std::uniform_int_distribution<> pick(1, 42);
-        return pick(smith::rng);
+        std::uniform_int_distribution<> pick(1, 42);
+        return pick(smith::ctx().rng);
     }
     else
-        return file_random_machine::using_file->get_random_num(1, 42, 2);
+        return using_file->get_random_num(1, 42, 2);
 }
 
 int d100()
 {
-    if (file_random_machine::using_file == NULL)
+    auto using_file = file_random_machine::using_file();
+    if (using_file == NULL)
     {
-        static std::uniform_int_distribution<> pick(1, 100);
-        return pick(smith::rng);
+        std::uniform_int_distribution<> pick(1, 100);
+        return pick(smith::ctx().rng);
     }
     else
-        return file_random_machine::using_file->get_random_num(1, 100, 2);
+        return using_file->get_random_num(1, 100, 2);
 }
 
 // random in range 1 - x
 int dx(int x)
 {
-    if (file_random_machine::using_file == NULL)
+    auto using_file = file_random_machine::using_file();
+    if (using_file == NULL)
     {
         std::uniform_int_distribution<> pick(1, x);
-        return pick(smith::rng);
+        return pick(smith::ctx().rng);
     }
     else
     {
@@ -92,7 +118,7 @@ int dx(int x)
             bytenum = 3;
         else
             bytenum = 4;
-        return file_random_machine::using_file->get_random_num(1, x, bytenum);
+        return using_file->get_random_num(1, x, bytenum);
     }
 }
 
@@ -149,11 +175,14 @@ file_random_machine::~file_random_machine()
         delete[] buffer;
 }
 
-map<string, struct file_random_machine *> file_random_machine::stream_map;
-struct file_random_machine *file_random_machine::using_file = NULL;
+struct file_random_machine *&file_random_machine::using_file()
+{
+    return smith::ctx().using_file;
+}
 
 struct file_random_machine *file_random_machine::get(string filename)
 {
+    auto &stream_map = smith::ctx().stream_map;
     if (stream_map.count(filename))
         return stream_map[filename];
     else
@@ -162,12 +191,12 @@ struct file_random_machine *file_random_machine::get(string filename)
 
 bool file_random_machine::map_empty()
 {
-    return stream_map.empty();
+    return smith::ctx().stream_map.empty();
 }
 
 void file_random_machine::use_file(string filename)
 {
-    using_file = get(filename);
+    using_file() = get(filename);
 }
 
 int file_random_machine::get_random_num(int min, int max, int byte_num)
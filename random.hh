@@ -18,11 +18,7 @@
 #include <memory>
 #include <iostream>
 #include <cstring>
-
-namespace smith
-{
-    extern std::mt19937_64 rng;
-}
+#include <set>
 
 using std::cout;
 using std::endl;
@@ -45,8 +41,8 @@ struct file_random_machine
     int end_pos;
     int read_byte;
 
-    static struct file_random_machine *using_file;
-    static map<string, struct file_random_machine *> stream_map;
+    // both are those of the calling thread, see smith::gen_context
+    static struct file_random_machine *&using_file();
     static struct file_random_machine *get(string filename);
     static bool map_empty();
     static void use_file(string filename);
@@ -56,6 +52,53 @@ struct file_random_machine
     int get_random_num(int min, int max, int byte_num);
 };
 
+namespace smith
+{
+    /**
+     * All the state of one statement generator: the random source and the
+     * counters and flags the grammar keeps while generating. Each thread
+     * generates with its own context, so several generators can run
+     * concurrently, each deterministic for its seed. A forked child goes on
+     * with a copy of the context of the thread that forked it.
+     */
+    struct gen_context
+    {
+        std::mt19937_64 rng;
+        struct file_random_machine *using_file = NULL;
+        map<string, struct file_random_machine *> stream_map;
+
+        int write_op_id = 0;
+        int row_id = 10000;
+
+        int use_group = 2;       // 0->no group, 1->use group, 2->to_be_define
+        int in_update_set_list = 0;
+        int in_in_clause = 0;    // 0-> not in "in" clause, 1-> in "in" clause (cannot use limit)
+        int in_check_clause = 0; // 0-> not in "check" clause, 1-> in "check" clause (cannot use subquery)
+        std::set<string> update_used_column_ref;
+
+        std::set<string> created_column_names;
+        std::set<string> exist_table_names;
+        bool exist_table_names_init = false;
+        std::set<string> exist_index_names;
+        bool exist_index_names_init = false;
+
+        // recursion depth of the retries in the factories and test helpers
+        int txn_factory_recur_time = 0;
+        int schema_try_time = 0;
+    };
+
+    // context of the calling thread
+    gen_context &ctx();
+
+    // Makes the calling thread generate with c until the guard is destroyed.
+    struct context_guard
+    {
+        gen_context *prev;
+        context_guard(gen_context &c);
+        ~context_guard();
+    };
+}
+
 template <typename T>
 T &random_pick(std::vector<T> &container)
 {
@@ -64,10 +107,10 @@ T &random_pick(std::vector<T> &container)
         throw std::runtime_error("No candidates available");
     }
 
-    if (file_random_machine::using_file == NULL)
+    if (file_random_machine::using_file() == NULL)
     {
         std::uniform_int_distribution<int> pick(0, container.size() - 1);
-        return container[pick(smith::rng)];
+        return container[pick(smith::ctx().rng)];
     }
     else
         return container[dx(container.size()) - 1];
@@ -79,10 +122,10 @@ I random_pick(I beg, I end)
     if (beg == end)
         throw std::runtime_error("No candidates available");
 
-    if (file_random_machine::using_file == NULL)
+    if (file_random_machine::using_file() == NULL)
     {
         std::uniform_int_distribution<> pick(0, std::distance(beg, end) - 1);
-        std::advance(beg, pick(smith::rng));
+        std::advance(beg, pick(smith::ctx().rng));
         return beg;
     }
     else
@@ -1,6 +1,6 @@
 #include "relmodel.hh"
 
-map<string, sqltype *> sqltype::typemap;
+thread_local map<string, sqltype *> sqltype::typemap;
 
 sqltype *sqltype::get(string n)
 {
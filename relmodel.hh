@@ -20,7 +20,8 @@ using std::vector;
 struct sqltype
 {
     string name;
-    static map<string, struct sqltype *> typemap;
+    // per thread: a schema is only used by the thread that loaded it
+    static thread_local map<string, struct sqltype *> typemap;
     static struct sqltype *get(string s);
     sqltype(string n) : name(n) {}
     virtual ~sqltype() {}
@@ -1,4 +1,5 @@
 #include <typeinfo>
+#include <algorithm>
 #include "config.h"
 #include "schema.hh"
 #include "relmodel.hh"
@@ -68,3 +69,42 @@ void schema::generate_indexes()
     assert(internaltype);
     assert(arraytype);
 }
+
+void schema::add_table(const table &t)
+{
+    // base tables come first, sorted by name, then the views
+    auto pos = tables.begin();
+    while (pos != tables.end() && pos->is_base_table && pos->name < t.name)
+        pos++;
+    tables.insert(pos, t);
+
+    // the pointers into tables moved
+    tables_with_columns_of_type.clear();
+    base_tables.clear();
+    for (auto &type : types)
+    {
+        for (auto &tab : tables)
+        {
+            for (auto &c : tab.columns())
+            {
+                if (type->consistent(c.type))
+                {
+                    tables_with_columns_of_type.insert(pair<sqltype *, table *>(type, &tab));
+                    break;
+                }
+            }
+        }
+    }
+    for (auto &tab : tables)
+    {
+        if (tab.is_base_table)
+            base_tables.push_back(&tab);
+    }
+}
+
+void schema::add_index(const string &name)
+{
+    auto pos = lower_bound(indexes.begin(), indexes.end(), name);
+    if (pos == indexes.end() || *pos != name)
+        indexes.insert(pos, name);
+}
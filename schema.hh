@@ -101,6 +101,12 @@ struct schema
     schema() {}
     // virtual void update_schema() = 0; // only update dynamic information, e.g. table, columns, index
     void generate_indexes();
+
+    // Add a base table or a (non-unique) index created by the generator,
+    // ordered as if the schema were loaded again. Scopes filled before
+    // add_table() point to the old tables.
+    void add_table(const table &t);
+    void add_index(const string &name);
 };
 
 #endif
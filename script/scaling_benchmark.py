@@ -0,0 +1,87 @@
+#! /bin/env python3
+# Runs transfuzz on growing history shapes and reports how the time of each
+# test phase grows with them, from the --test-log of each run.
+import os, time, signal, argparse, subprocess, csv, statistics
+
+PHASES = ["gen_ms", "schedule_ms", "instrument_ms", "run_ms", "analyze_ms"]
+
+
+def parse_shape(shape):
+    # <txns>x<stmts per txn>[x<concurrent txns>]
+    parts = [int(p) for p in shape.split("x")]
+    if len(parts) == 2:
+        parts.append(max(1, parts[0] // 2))
+    assert len(parts) == 3, f"bad shape {shape}"
+    return parts
+
+
+def run_shape(transfuzz, dbms_options, shape, seconds, log_dir):
+    txns, stmts, concurrent = shape
+    log_file = f"{log_dir}/txns{txns}_stmts{stmts}_conc{concurrent}.tsv"
+    if os.path.exists(log_file):
+        os.remove(log_file)
+    command = [transfuzz] + dbms_options + [
+        f"--txns={txns}",
+        f"--txn-stmts={stmts}",
+        f"--concurrent-txns={concurrent}",
+        f"--test-log={log_file}",
+    ]
+    print(f"Running {' '.join(command)} for {seconds}s")
+    with open(f"{log_file}.out", "w") as out:
+        process = subprocess.Popen(command, stdout=out, stderr=subprocess.STDOUT, start_new_session=True)
+        try:
+            process.wait(timeout=seconds)
+        except subprocess.TimeoutExpired:
+            os.killpg(process.pid, signal.SIGKILL)
+            process.wait()
+    return log_file
+
+
+def summarize(log_file):
+    if not os.path.exists(log_file):
+        return None
+    with open(log_file) as f:
+        rows = [row for row in csv.DictReader(f, delimiter="\t") if row["time"] != "time"]
+    passed = [row for row in rows if row["outcome"] == "passed"]
+    summary = {"tests": len(rows), "passed": len(passed)}
+    if not passed:
+        return summary
+    summary["stmts"] = statistics.mean(int(row["instrumented_stmts"]) for row in passed)
+    for phase in PHASES:
+        summary[phase] = statistics.mean(int(row[phase]) for row in passed)
+    return summary
+
+
+# every other option, e.g. --mysql-db=testdb --mysql-port=3306, is passed to transfuzz
+parser = argparse.ArgumentParser()
+parser.add_argument("--transfuzz", help="Path of the transfuzz binary", type=str, default="./transfuzz")
+parser.add_argument("--shapes", help="Comma separated <txns>x<stmts per txn>[x<concurrent txns>]", type=str,
+                    default="6x4x3,24x8,96x16")
+parser.add_argument("--seconds", help="Fuzzing time per shape", type=int, default=300)
+parser.add_argument("--log-dir", help="Directory of the test logs", type=str, default="scaling_benchmark")
+
+args, dbms_options = parser.parse_known_args()
+if not dbms_options:
+    parser.error("no target options of transfuzz, e.g. --mysql-db=testdb --mysql-port=3306")
+os.makedirs(args.log_dir, exist_ok=True)
+
+results = []
+for shape in args.shapes.split(","):
+    shape = parse_shape(shape)
+    log_file = run_shape(args.transfuzz, dbms_options, shape, args.seconds, args.log_dir)
+    results.append((shape, summarize(log_file)))
+    time.sleep(1)
+
+print("\n\nMean time of the passed tests (ms):")
+print("   txns  stmts/txn  concurrent  tests  passed  instrumented  " + "  ".join(p.rjust(13) for p in PHASES))
+for (txns, stmts, concurrent), summary in results:
+    line = f"{txns:7}  {stmts:9}  {concurrent:10}"
+    if summary is None:
+        print(line + "  no test log")
+        continue
+    line += f"  {summary['tests']:5}  {summary['passed']:6}"
+    if summary["passed"] == 0:
+        print(line)
+        continue
+    line += f"  {summary['stmts']:12.0f}  " + "  ".join(f"{summary[p]:13.1f}" for p in PHASES)
+    print(line)
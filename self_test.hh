@@ -0,0 +1,16 @@
+/// @file
+/// @brief Checks of the backup, content and prepared-read paths, run by --self-test
+
+#ifndef SELF_TEST_HH
+#define SELF_TEST_HH
+
+#include "dbms_info.hh"
+
+/**
+ * Runs the checks against the server of d_info, on the database
+ * "<test_db>_self_test", so that the target database is left as it is.
+ * The checks database is left empty. Returns the number of failures.
+ */
+int run_self_test(dbms_info &d_info);
+
+#endif
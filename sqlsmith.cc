@@ -121,9 +121,9 @@ int main(int argc, char *argv[])
         schema->fill_scope(scope);
 
         if (options.count("rng-state")) {
-	        istringstream(options["rng-state"]) >> smith::rng;
+	        istringstream(options["rng-state"]) >> smith::ctx().rng;
         } else {
-	        smith::rng.seed(options.count("seed") ? stoi(options["seed"]) : getpid());
+	        smith::ctx().rng.seed(options.count("seed") ? stoi(options["seed"]) : getpid());
         }
 
         vector<shared_ptr<logger> > loggers;
@@ -0,0 +1,184 @@
+#include "stmt_executor.hh"
+
+#include <stdexcept>
+#include <sys/time.h>
+
+extern "C"
+{
+#include <sys/epoll.h>
+#include <unistd.h>
+}
+
+#define debug_info (string(__func__) + "(" + string(__FILE__) + ":" + to_string(__LINE__) + ")")
+
+#define MAX_EPOLL_EVENTS 64
+
+static unsigned long long get_cur_time_ms(void)
+{
+    struct timeval tv;
+    struct timezone tz;
+
+    gettimeofday(&tv, &tz);
+
+    return (tv.tv_sec * 1000ULL) + tv.tv_usec / 1000;
+}
+
+stmt_executor::stmt_executor()
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+        throw std::runtime_error("epoll_create1 fails\nLocation: " + debug_info);
+}
+
+stmt_executor::~stmt_executor()
+{
+    close(epoll_fd);
+}
+
+void stmt_executor::clear()
+{
+    for (auto &[slot, p] : pendings)
+        unwatch(p);
+    pendings.clear();
+}
+
+bool stmt_executor::in_flight(int slot)
+{
+    return pendings.count(slot) > 0;
+}
+
+vector<int> stmt_executor::finished_slots()
+{
+    vector<int> slots;
+    for (auto &[slot, p] : pendings)
+    {
+        if (p.finished)
+            slots.push_back(slot);
+    }
+    return slots;
+}
+
+set<unsigned long> stmt_executor::lock_holders(int slot)
+{
+    if (pendings.count(slot) == 0)
+        return set<unsigned long>();
+    return pendings[slot].holders;
+}
+
+void stmt_executor::unwatch(pending_stmt &p)
+{
+    if (p.fd < 0)
+        return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, p.fd, NULL);
+    p.fd = -1;
+}
+
+bool stmt_executor::advance(pending_stmt &p)
+{
+    if (p.finished)
+        return true;
+
+    try
+    {
+        if (p.prepared)
+            p.finished = p.dut->async_test_prepared(p.stmt, &p.output, &p.affected_row_num);
+        else
+            p.finished = p.dut->async_test(p.stmt, &p.output, &p.affected_row_num);
+    }
+    catch (exception &e)
+    {
+        p.finished = true;
+        p.err = e.what();
+    }
+
+    if (p.finished)
+        unwatch(p);
+    return p.finished;
+}
+
+void stmt_executor::submit(int slot, shared_ptr<dut_base> &dut, const string &stmt, bool prepared)
+{
+    pending_stmt p;
+    p.dut = dut;
+    p.stmt = stmt;
+    p.prepared = prepared;
+    p.fd = -1;
+    p.finished = false;
+    p.affected_row_num = 0;
+
+    // sending is the first step of async_test
+    if (advance(p) == false)
+    {
+        p.fd = dut->socket_fd();
+        if (p.fd >= 0)
+        {
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.fd = p.fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, p.fd, &ev) < 0)
+                p.fd = -1; // not watchable, it is still advanced on every timeout
+        }
+    }
+    pendings[slot] = p;
+}
+
+void stmt_executor::poll_all(int timeout_ms)
+{
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, timeout_ms);
+
+    // the client library may have buffered data that does not wake epoll,
+    // so every pending statement is advanced, not only the readable ones
+    for (auto &[slot, p] : pendings)
+        advance(p);
+}
+
+bool stmt_executor::wait(int timeout_ms)
+{
+    if (pendings.empty())
+        return false;
+    poll_all(timeout_ms);
+    return true;
+}
+
+void stmt_executor::test(int slot, shared_ptr<dut_base> dut, const string &stmt,
+                         vector<vector<string>> *output, int *affected_row_num,
+                         bool prepared)
+{
+    if (pendings.count(slot) == 0)
+        submit(slot, dut, stmt, prepared);
+
+    auto &p = pendings[slot];
+    if (p.stmt != stmt)
+        throw std::runtime_error("sent sql stmt changed in " + debug_info +
+                                 "\nsent_sql: " + p.stmt +
+                                 "\nstmt: " + stmt);
+
+    auto begin_time = get_cur_time_ms();
+    while (p.finished == false)
+    {
+        auto cur_time = get_cur_time_ms();
+        if (cur_time - begin_time >= EXECUTOR_BLOCK_CHECK_MS)
+        {
+            if (p.dut->is_blocked())
+            {
+                p.dut->lock_holders(p.holders);
+                throw std::runtime_error("blocked in " + debug_info);
+            }
+            begin_time = cur_time;
+            continue;
+        }
+        poll_all(EXECUTOR_BLOCK_CHECK_MS - (cur_time - begin_time));
+    }
+
+    auto finished = std::move(p);
+    pendings.erase(slot);
+
+    if (!finished.err.empty())
+        throw std::runtime_error(finished.err);
+
+    if (output)
+        *output = finished.output;
+    if (affected_row_num)
+        *affected_row_num = finished.affected_row_num;
+}
@@ -0,0 +1,86 @@
+/// @file
+/// @brief epoll-driven executor running the statements of all transactions
+
+#ifndef STMT_EXECUTOR_HH
+#define STMT_EXECUTOR_HH
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+
+#include "dut.hh"
+
+using namespace std;
+
+// how often a statement that is still waiting is checked for lock waits
+#define EXECUTOR_BLOCK_CHECK_MS 100
+
+/**
+ * Owns the sockets of every transaction connection and drives all in-flight
+ * statements at once. A statement stays in flight when it is blocked, so a
+ * blocked statement whose lock is released finishes in the background while
+ * the scheduler waits on another one, and its result is handed back when the
+ * scheduler retries it.
+ *
+ * Each connection is identified by a slot (the transaction id).
+ */
+class stmt_executor
+{
+public:
+    stmt_executor();
+    ~stmt_executor();
+
+    /**
+     * Same contract as dut_base::test(): returns once stmt has finished,
+     * rethrows its error, or throws "blocked" if it waits for a lock.
+     * Calling it again with the same stmt picks up the in-flight one.
+     * If prepared is true, stmt is run through async_test_prepared().
+     */
+    void test(int slot, shared_ptr<dut_base> dut, const string &stmt,
+              vector<vector<string>> *output = NULL, int *affected_row_num = NULL,
+              bool prepared = false);
+
+    // true if slot has a statement that is sent but not handed back yet
+    bool in_flight(int slot);
+
+    // slots whose blocked statement has finished in the background
+    vector<int> finished_slots();
+
+    // wait up to timeout_ms for the in-flight statements to make progress,
+    // false if nothing is in flight
+    bool wait(int timeout_ms);
+
+    // sessions that held the locks of slot when it was found blocked
+    set<unsigned long> lock_holders(int slot);
+
+    // forget everything, e.g. when the connections are recreated
+    void clear();
+
+private:
+    struct pending_stmt
+    {
+        shared_ptr<dut_base> dut;
+        string stmt;
+        bool prepared;
+        int fd;
+        bool finished;
+        string err;
+        vector<vector<string>> output;
+        int affected_row_num;
+        set<unsigned long> holders;
+    };
+
+    int epoll_fd;
+    map<int, pending_stmt> pendings;
+
+    void submit(int slot, shared_ptr<dut_base> &dut, const string &stmt, bool prepared);
+    // advance one pending statement, true if it is finished
+    bool advance(pending_stmt &p);
+    // wait up to timeout_ms for any socket, then advance every pending statement
+    void poll_all(int timeout_ms);
+    void unwatch(pending_stmt &p);
+};
+
+#endif
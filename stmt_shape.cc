@@ -0,0 +1,199 @@
+#include "stmt_shape.hh"
+
+#include <set>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+static bool is_word_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '_' || c == '$';
+}
+
+// keywords opening a condition whose literals become parameters
+static const set<string> predicate_begin = {"WHERE", "ON", "HAVING"};
+// keywords ending it: what follows is not a plain value comparison
+static const set<string> predicate_end = {
+    "SELECT", "ORDER", "GROUP", "LIMIT", "UNION", "INTERSECT", "EXCEPT",
+    "FOR", "LOCK", "WINDOW", "INTO", "SET", "VALUES", "AS"};
+// keywords whose next literal must stay a literal
+static const set<string> literal_only = {
+    "ESCAPE", "COLLATE", "DATE", "TIME", "TIMESTAMP"};
+
+// Reads the string literal starting at stmt[begin] (a quote), and returns the
+// position after it. value is its content if it has no backslash escape.
+static size_t read_string(const string &stmt, size_t begin, string &value, bool &plain)
+{
+    auto quote = stmt[begin];
+    value.clear();
+    plain = true;
+    auto i = begin + 1;
+    while (i < stmt.size())
+    {
+        auto c = stmt[i];
+        if (c == '\\')
+        {
+            plain = false;
+            i += 2;
+            continue;
+        }
+        if (c == quote)
+        {
+            if (i + 1 < stmt.size() && stmt[i + 1] == quote)
+            { // doubled quote
+                value += c;
+                i += 2;
+                continue;
+            }
+            return i + 1;
+        }
+        value += c;
+        i++;
+    }
+    plain = false; // not terminated
+    return i;
+}
+
+// Reads the number starting at stmt[begin], and returns the position after it.
+static size_t read_number(const string &stmt, size_t begin, stmt_param &param)
+{
+    auto i = begin;
+    auto digits = [&]()
+    {
+        while (i < stmt.size() && isdigit((unsigned char)stmt[i]))
+            i++;
+    };
+
+    param.kind = stmt_param::PARAM_INTEGER;
+    digits();
+    if (i < stmt.size() && stmt[i] == '.')
+    {
+        param.kind = stmt_param::PARAM_DECIMAL;
+        i++;
+        digits();
+    }
+    if (i + 1 < stmt.size() && (stmt[i] == 'e' || stmt[i] == 'E'))
+    {
+        auto exponent = i + 1;
+        if (exponent + 1 < stmt.size() && (stmt[exponent] == '+' || stmt[exponent] == '-'))
+            exponent++;
+        if (isdigit((unsigned char)stmt[exponent]))
+        {
+            param.kind = stmt_param::PARAM_REAL;
+            i = exponent;
+            digits();
+        }
+    }
+    param.text = stmt.substr(begin, i - begin);
+    return i;
+}
+
+string stmt_shape(const string &stmt, vector<stmt_param> &params)
+{
+    params.clear();
+    string shape;
+    shape.reserve(stmt.size());
+
+    bool in_predicate = false;
+    // in_predicate outside of each open parenthesis
+    vector<bool> outer_predicate;
+    string last_word;
+
+    size_t i = 0;
+    while (i < stmt.size())
+    {
+        auto c = stmt[i];
+        auto next = i + 1 < stmt.size() ? stmt[i + 1] : '\0';
+        // a literal glued to a word or a dot is part of a name (t1, x.5),
+        // a charset introducer (_utf8'a') or a typed literal (X'1F')
+        auto glued = i > 0 && (is_word_char(stmt[i - 1]) || stmt[i - 1] == '.');
+
+        if (c == '?' || c == '#' || (c == '-' && next == '-') || (c == '/' && next == '*'))
+        {
+            params.clear();
+            return stmt;
+        }
+
+        if (c == '`' || c == '"' || c == '\'')
+        {
+            string value;
+            bool plain;
+            auto end = read_string(stmt, i, value, plain);
+            if (c == '\'' && plain && in_predicate && !glued && !literal_only.count(last_word))
+            {
+                stmt_param param;
+                param.kind = stmt_param::PARAM_TEXT;
+                param.text = value;
+                params.push_back(param);
+                shape += '?';
+            }
+            else
+                shape.append(stmt, i, end - i);
+            last_word = "";
+            i = end;
+            continue;
+        }
+
+        if (isdigit((unsigned char)c) && !glued)
+        {
+            stmt_param param;
+            auto end = read_number(stmt, i, param);
+            auto is_literal = end >= stmt.size() || !is_word_char(stmt[end]); // not 0x1F or 1abc
+            if (is_literal && param.kind == stmt_param::PARAM_INTEGER)
+            {
+                errno = 0;
+                param.int_value = strtoll(param.text.c_str(), NULL, 10);
+                is_literal = errno == 0;
+            }
+            if (is_literal && param.kind == stmt_param::PARAM_REAL)
+                param.real_value = strtod(param.text.c_str(), NULL);
+
+            if (is_literal && in_predicate && !literal_only.count(last_word))
+            {
+                params.push_back(param);
+                shape += '?';
+                i = end;
+            }
+            else
+            {
+                while (end < stmt.size() && is_word_char(stmt[end]))
+                    end++;
+                shape.append(stmt, i, end - i);
+                i = end;
+            }
+            last_word = "";
+            continue;
+        }
+
+        if (is_word_char(c))
+        {
+            auto end = i;
+            while (end < stmt.size() && is_word_char(stmt[end]))
+                end++;
+            last_word = stmt.substr(i, end - i);
+            for (auto &w : last_word)
+                w = toupper((unsigned char)w);
+            if (predicate_begin.count(last_word))
+                in_predicate = true;
+            else if (predicate_end.count(last_word))
+                in_predicate = false;
+            shape.append(stmt, i, end - i);
+            i = end;
+            continue;
+        }
+
+        if (c == '(')
+            outer_predicate.push_back(in_predicate);
+        else if (c == ')' && !outer_predicate.empty())
+        {
+            in_predicate = outer_predicate.back();
+            outer_predicate.pop_back();
+        }
+        if (!isspace((unsigned char)c))
+            last_word = "";
+        shape += c;
+        i++;
+    }
+    return shape;
+}
@@ -0,0 +1,41 @@
+/// @file
+/// @brief Shapes of statements whose predicate literals become parameters
+
+#ifndef STMT_SHAPE_HH
+#define STMT_SHAPE_HH
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A literal taken out of a statement, to be bound to its "?" in the shape.
+ */
+struct stmt_param
+{
+    enum param_kind
+    {
+        PARAM_INTEGER, // bound as BIGINT
+        PARAM_DECIMAL, // bound as DECIMAL, from text
+        PARAM_REAL,    // bound as DOUBLE
+        PARAM_TEXT     // bound as a string, unquoted
+    } kind;
+    string text;
+    long long int_value;
+    double real_value;
+};
+
+/**
+ * Replaces the literals of the WHERE, ON and HAVING conditions of stmt
+ * by "?", and appends them to params in order. Statements that differ only
+ * in these literals share the same shape, so one server-side prepared
+ * statement serves all of them.
+ * Literals elsewhere (select list, ORDER BY, LIMIT, ...) are kept, since
+ * a parameter there would change the result type or the meaning of the
+ * statement. Returns stmt unchanged, with no params, if it has comments or
+ * placeholders of its own.
+ */
+string stmt_shape(const string &stmt, vector<stmt_param> &params);
+
+#endif
@@ -2,8 +2,12 @@
 #include <cassert>
 #include <cstring>
 #include "tidb.hh"
+#include "backup_store.hh"
+#include "client_stmt.hh"
 #include <iostream>
 #include <set>
+#include <type_traits>
+#include <memory>
 
 #ifndef HAVE_BOOST_REGEX
 #include <regex>
@@ -69,36 +73,31 @@ tidb_connection::~tidb_connection()
 schema_tidb::schema_tidb(string db, unsigned int port)
     : tidb_connection(db, port)
 {
-    // cerr << "Loading tables...";
-    string get_table_query = "SELECT DISTINCT TABLE_NAME FROM INFORMATION_SCHEMA.TABLES \
-        WHERE TABLE_SCHEMA='" +
-                             db + "' AND \
-              TABLE_TYPE='BASE TABLE' ORDER BY 1;";
-
-    if (mysql_real_query(&mysql, get_table_query.c_str(), get_table_query.size()))
-        throw std::runtime_error(string(mysql_error(&mysql)) + " in schema_tidb (load table list)!");
+    // cerr << "Loading tables, views and their columns...";
+    // one round trip for all relations: base tables by name, then views by
+    // name, each with its columns in ordinal order
+    string get_column_query = "SELECT T.TABLE_NAME, T.TABLE_TYPE, C.COLUMN_NAME, C.DATA_TYPE \
+        FROM INFORMATION_SCHEMA.TABLES T JOIN INFORMATION_SCHEMA.COLUMNS C \
+            ON C.TABLE_SCHEMA = T.TABLE_SCHEMA AND C.TABLE_NAME = T.TABLE_NAME \
+        WHERE T.TABLE_SCHEMA='" +
+                              db + "' AND \
+            T.TABLE_TYPE IN ('BASE TABLE', 'VIEW') \
+        ORDER BY T.TABLE_TYPE, T.TABLE_NAME, C.ORDINAL_POSITION;";
+
+    if (mysql_real_query(&mysql, get_column_query.c_str(), get_column_query.size()))
+        throw std::runtime_error(string(mysql_error(&mysql)) + " in schema_tidb (load tables and columns)!");
 
     auto result = mysql_store_result(&mysql);
     while (auto row = mysql_fetch_row(result))
     {
-        table tab(row[0], "main", true, true);
-        tables.push_back(tab);
-    }
-    mysql_free_result(result);
-    // cerr << "done." << endl;
-
-    // cerr << "Loading views...";
-    string get_view_query = "select distinct table_name from information_schema.views \
-        where table_schema='" +
-                            db + "' order by 1;";
-    if (mysql_real_query(&mysql, get_view_query.c_str(), get_view_query.size()))
-        throw std::runtime_error(string(mysql_error(&mysql)) + " in schema_tidb (load view list)!");
-
-    result = mysql_store_result(&mysql);
-    while (auto row = mysql_fetch_row(result))
-    {
-        table tab(row[0], "main", false, false);
-        tables.push_back(tab);
+        if (tables.empty() || tables.back().name != row[0])
+        {
+            bool is_base_table = string(row[1]) == "BASE TABLE";
+            table tab(row[0], "main", is_base_table, is_base_table);
+            tables.push_back(tab);
+        }
+        column c(row[2], sqltype::get(row[3]));
+        tables.back().columns().push_back(c);
     }
     mysql_free_result(result);
     // cerr << "done." << endl;
@@ -121,26 +120,6 @@ schema_tidb::schema_tidb(string db, unsigned int port)
     mysql_free_result(result);
     // cerr << "done." << endl;
 
-    // cerr << "Loading columns and constraints...";
-    for (auto &t : tables)
-    {
-        string get_column_query = "SELECT COLUMN_NAME, DATA_TYPE FROM INFORMATION_SCHEMA.COLUMNS \
-                WHERE TABLE_NAME='" +
-                                  t.ident() + "' AND \
-                    TABLE_SCHEMA='" +
-                                  db + "'  ORDER BY ORDINAL_POSITION;";
-        if (mysql_real_query(&mysql, get_column_query.c_str(), get_column_query.size()))
-            throw std::runtime_error(string(mysql_error(&mysql)) + " in schema_tidb (load table " + t.ident() + ")!");
-        result = mysql_store_result(&mysql);
-        while (auto row = mysql_fetch_row(result))
-        {
-            column c(row[0], sqltype::get(row[1]));
-            t.columns().push_back(c);
-        }
-        mysql_free_result(result);
-    }
-    // cerr << "done." << endl;
-
     booltype = sqltype::get("tinyint");
     inttype = sqltype::get("integer");
     realtype = sqltype::get("double");
@@ -550,6 +529,11 @@ dut_tidb::dut_tidb(string db, unsigned int port)
 {
 }
 
+dut_tidb::~dut_tidb()
+{
+    drop_prepared_stmts();
+}
+
 void dut_tidb::test(const std::string &stmt, vector<vector<string>> *output, int *affected_row_num)
 {
     if (mysql_real_query(&mysql, stmt.c_str(), stmt.size()))
@@ -584,26 +568,124 @@ void dut_tidb::test(const std::string &stmt, vector<vector<string>> *output, int
         }
 
         auto column_num = mysql_num_fields(result);
+        output->reserve(output->size() + mysql_num_rows(result));
         while (auto row = mysql_fetch_row(result))
         {
-            vector<string> row_output;
+            output->emplace_back();
+            auto &row_output = output->back();
+            row_output.reserve(column_num);
             for (int i = 0; i < column_num; i++)
             {
-                string str;
                 if (row[i] == NULL)
-                    str = "NULL";
+                    row_output.emplace_back("NULL");
                 else
-                    str = row[i];
-                row_output.push_back(str);
+                    row_output.emplace_back(row[i]);
             }
-            output->push_back(row_output);
         }
     }
     mysql_free_result(result);
 }
 
+// Returns the prepared statement of stmt (a shape, or an exact statement) on
+// this connection, and prepares it on first use. NULL if it has to go through
+// the text protocol.
+MYSQL_STMT *dut_tidb::prepared_stmt(const string &stmt)
+{
+    auto iter = prepared_stmts.find(stmt);
+    if (iter != prepared_stmts.end())
+        return iter->second;
+
+    if (prepared_stmts.size() >= TIDB_MAX_PREPARED_STMTS)
+        drop_prepared_stmts();
+
+    auto st = mysql_stmt_init(&mysql);
+    if (st != NULL &&
+        (mysql_stmt_prepare(st, stmt.c_str(), stmt.size()) != 0 ||
+         binary_result_is_exact(st) == false))
+    {
+        mysql_stmt_close(st);
+        st = NULL;
+    }
+    prepared_stmts[stmt] = st;
+    return st;
+}
+
+void dut_tidb::drop_prepared_stmts()
+{
+    for (auto &[stmt, st] : prepared_stmts)
+    {
+        if (st != NULL)
+            mysql_stmt_close(st);
+    }
+    prepared_stmts.clear();
+}
+
+int dut_tidb::socket_fd()
+{
+    return mysql.net.fd;
+}
+
+// the tidb client is blocking, so the statement is finished when it returns
+bool dut_tidb::async_test_prepared(const string &stmt, vector<vector<string>> *output, int *affected_row_num)
+{
+    // see dut_mariadb::async_test_prepared()
+    vector<stmt_param> params;
+    vector<MYSQL_BIND> binds;
+    auto st = prepared_stmt(stmt_shape(stmt, params));
+    if (st == NULL && !params.empty())
+    {
+        params.clear();
+        st = prepared_stmt(stmt);
+    }
+    if (st == NULL || !bind_stmt_params(st, params, binds))
+    {
+        test(stmt, output, affected_row_num);
+        return true;
+    }
+
+    if (mysql_stmt_execute(st) || mysql_stmt_store_result(st))
+    {
+        string err = mysql_stmt_error(st);
+        mysql_stmt_free_result(st);
+        if (regex_match(err, e_crash))
+            throw std::runtime_error("BUG!!! " + err + " in dut_tidb::async_test_prepared!");
+        throw std::runtime_error(err + " in dut_tidb::async_test_prepared!");
+    }
+
+    if (affected_row_num)
+        *affected_row_num = mysql_stmt_affected_rows(st);
+
+    try
+    {
+        fetch_stmt_result(st, output);
+    }
+    catch (...)
+    {
+        mysql_stmt_free_result(st);
+        throw;
+    }
+    mysql_stmt_free_result(st);
+    return true;
+}
+
+bool dut_tidb::reset_session()
+{
+    try
+    {
+        test("ROLLBACK;");
+    }
+    catch (exception &e)
+    {
+        return false;
+    }
+    return true;
+}
+
 void dut_tidb::reset(void)
 {
+    // the tables are recreated, maybe with other columns
+    drop_prepared_stmts();
+
     string drop_sql = "drop database if exists " + test_db + "; ";
     if (mysql_real_query(&mysql, drop_sql.c_str(), drop_sql.size()))
     {
@@ -634,41 +716,57 @@ void dut_tidb::reset(void)
 
 void dut_tidb::backup(void)
 {
-    string mysql_dump = "mysqldump -h 127.0.0.1 -P " + to_string(test_port) + " -u root " + test_db + " > /tmp/mysql_bk.sql";
-    int ret = system(mysql_dump.c_str());
-    if (ret != 0)
-    {
-        cerr << "backup fail in dut_tidb::backup!!" << endl;
-        throw std::runtime_error("backup fail in dut_tidb::backup");
-    }
+    backup_capture(*this, test_db, backup_file_path("tidb", test_db, test_port));
 }
 
 void dut_tidb::reset_to_backup(void)
 {
     reset();
-    string bk_file = "/tmp/mysql_bk.sql";
+    auto bk_file = backup_file_path("tidb", test_db, test_port);
+    auto bk_stmts = backup_load(bk_file);
+    if (bk_stmts)
+    {
+        for (auto &stmt : *bk_stmts)
+            test(stmt);
+        return;
+    }
     if (access(bk_file.c_str(), F_OK) == -1)
         return;
 
+    // not written by backup(), e.g. the mysqldump file of an older bug report
     mysql_close(&mysql);
 
-    string mysql_source = "mysql -h 127.0.0.1 -P " + to_string(test_port) + " -u root -D " + test_db + " < /tmp/mysql_bk.sql";
+    string mysql_source = "mysql -h 127.0.0.1 -P " + to_string(test_port) + " -u root -D " + test_db + " < " + bk_file;
     if (system(mysql_source.c_str()) == -1)
         throw std::runtime_error(string("system() error, return -1") + " in dut_tidb::reset_to_backup!");
 
+    // the connection is reused by the pool, so it must be fully set up again
+    if (!mysql_init(&mysql))
+        throw std::runtime_error(string(mysql_error(&mysql)) + " in dut_tidb::reset_to_backup!");
+
     if (!mysql_real_connect(&mysql, "127.0.0.1", "root", NULL, test_db.c_str(), test_port, NULL, 0))
         throw std::runtime_error(string(mysql_error(&mysql)) + " in dut_tidb::reset_to_backup!");
 }
 
-int dut_tidb::save_backup_file(string path)
+void dut_tidb::save_snapshot()
+{
+    snapshot_save(*this, test_db);
+}
+
+bool dut_tidb::restore_snapshot()
+{
+    return snapshot_restore(*this, test_db, "DELETE FROM");
+}
+
+int dut_tidb::save_backup_file(string path, string db, unsigned int port)
 {
-    string cp_cmd = "cp /tmp/mysql_bk.sql " + path;
+    string cp_cmd = "cp " + backup_file_path("tidb", db, port) + " " + path + "/" + BACKUP_REPORT_FILE;
     return system(cp_cmd.c_str());
 }
 
-int dut_tidb::use_backup_file(string backup_file)
+int dut_tidb::use_backup_file(string backup_file, string db, unsigned int port)
 {
-    string cp_cmd = "cp " + backup_file + " /tmp/mysql_bk.sql";
+    string cp_cmd = "cp " + backup_file + " " + backup_file_path("tidb", db, port);
     return system(cp_cmd.c_str());
 }
 
@@ -13,6 +13,9 @@ extern "C"
 #include "relmodel.hh"
 #include "dut.hh"
 
+// prepared statements kept per connection before they are all dropped
+#define TIDB_MAX_PREPARED_STMTS 256
+
 struct tidb_connection
 {
     MYSQL mysql;
@@ -35,12 +38,18 @@ struct schema_tidb : schema, tidb_connection
 struct dut_tidb : dut_base, tidb_connection
 {
     virtual void test(const std::string &stmt, vector<vector<string>> *output = NULL, int *affected_row_num = NULL);
+    virtual bool async_test_prepared(const string &stmt, vector<vector<string>> *output = NULL, int *affected_row_num = NULL);
     virtual void reset(void);
+    virtual bool reset_session();
+    // the client is blocking, the socket is only used to detach the connection
+    virtual int socket_fd();
 
     virtual void backup(void);
     virtual void reset_to_backup(void);
-    static int save_backup_file(string path);
-    static int use_backup_file(string backup_file);
+    virtual void save_snapshot();
+    virtual bool restore_snapshot();
+    static int save_backup_file(string path, string db, unsigned int port);
+    static int use_backup_file(string backup_file, string db, unsigned int port);
 
     virtual string commit_stmt();
     virtual string abort_stmt();
@@ -48,8 +57,15 @@ struct dut_tidb : dut_base, tidb_connection
 
     static pid_t fork_db_server();
 
+
     virtual void get_content(vector<string> &tables_name, map<string, vector<vector<string>>> &content);
     dut_tidb(string db, unsigned int port);
+    ~dut_tidb();
+
+    MYSQL_STMT *prepared_stmt(const string &stmt);
+    void drop_prepared_stmts();
+    // statements prepared on this connection, NULL if one has to use the text protocol
+    map<string, MYSQL_STMT *> prepared_stmts;
 };
 
 #endif
\ No newline at end of file
@@ -1,8 +1,15 @@
 #include "transaction_test.hh"
+#include "backup_store.hh"
 
-#define MAX_CONCURRENT_TXN_NUM 3
-#define TXN_NUM (MAX_CONCURRENT_TXN_NUM * 2)
-#define TXN_STMT_NUM 4
+static unsigned long long get_cur_time_ms(void)
+{
+    struct timeval tv;
+    struct timezone tz;
+
+    gettimeofday(&tv, &tz);
+
+    return (tv.tv_sec * 1000ULL) + tv.tv_usec / 1000;
+}
 
 /**
  * Populates the `tid_queue` with transaction IDs, which is the order
@@ -13,17 +20,14 @@ void transaction_test::assign_txn_id()
 {
     set<int> concurrent_tid;
     set<int> available_tid;
-    int tid_insertd_stmt[trans_num];
+    vector<int> tid_insertd_stmt(trans_num, 0);
     for (int i = 0; i < trans_num; i++)
-    {
         available_tid.insert(i);
-        tid_insertd_stmt[i] = 0;
-    }
 
     while (available_tid.empty() == false)
     {
         int tid;
-        if (concurrent_tid.size() < MAX_CONCURRENT_TXN_NUM)
+        if ((int)concurrent_tid.size() < test_dbms_info.concurrent_txn_num)
         {
             auto idx = dx(available_tid.size()) - 1;
             tid = *next(available_tid.begin(), idx);
@@ -73,16 +77,16 @@ void transaction_test::assign_txn_status()
 void transaction_test::gen_txn_stmts()
 {
     cerr << "generating statements ...             ";
-    int stmt_pos_of_trans[trans_num];
+    vector<int> stmt_pos_of_trans(trans_num, 0);
 
     // Schema of the current database state.
     db_schema = get_schema(test_dbms_info);
 
+    executor.clear();
     // cerr << "There are " << trans_num << " transactions." << endl;
     for (int tid = 0; tid < trans_num; tid++)
     {
         trans_arr[tid].dut = dut_setup(test_dbms_info);
-        stmt_pos_of_trans[tid] = 0;
 
         // cerr << "Generating statements for one transaction ... ";
         // save 2 stmts for begin and commit/abort
@@ -185,25 +189,13 @@ bool transaction_test::change_txn_status(int target_tid, txn_status final_status
     else if (final_status == TXN_COMMIT)
         trans_arr[target_tid].stmts.push_back(make_shared<txn_string_stmt>((prod *)0, trans_arr[target_tid].dut->commit_stmt()));
 
-    auto commit_str = trans_arr[target_tid].dut->commit_stmt();
-    auto abort_str = trans_arr[target_tid].dut->abort_stmt();
     for (int i = 0; i < stmt_num; i++)
     {
         auto tid = tid_queue[i];
         if (target_tid != tid)
             continue;
 
-        auto stmt = print_stmt_to_string(stmt_queue[i]);
-
-        // compare size to prevent the case that begin statement contains "COMMIT",
-        // e.g. BEGIN TRANSACTION ISOLATION LEVEL READ COMMITTED (in postgres)
-        auto is_commit = (stmt.find(commit_str) != string::npos) &&
-                         (stmt.size() <= commit_str.size() + 3) &&
-                         (stmt.size() >= commit_str.size());
-        auto is_abort = (stmt.find(abort_str) != string::npos) &&
-                        (stmt.size() <= abort_str.size() + 3) &&
-                        (stmt.size() >= abort_str.size());
-        if (!is_commit && !is_abort)
+        if (!render_stmt(stmt_queue[i])->is_txn_end())
             continue;
 
         // find out the commit or abort stmt
@@ -214,42 +206,40 @@ bool transaction_test::change_txn_status(int target_tid, txn_status final_status
 
 bool transaction_test::analyze_txn_dependency(shared_ptr<dependency_analyzer> &da)
 {
-    vector<stmt_output> init_content_vector;
-    for (auto iter = init_db_content.begin(); iter != init_db_content.end(); iter++)
-        init_content_vector.push_back(iter->second);
-
     vector<txn_status> real_txn_status;
     for (int tid = 0; tid < trans_num; tid++)
         real_txn_status.push_back(trans_arr[tid].status);
 
-    da = make_shared<dependency_analyzer>(init_content_vector, // init_output
-                                          real_output_queue,   // total_output
-                                          real_tid_queue,      // final_tid_queue
-                                          real_stmt_usage,     // final_stmt_usage
-                                          real_txn_status,     // final_txn_status
-                                          trans_num,           // t_num
-                                          1,                   // primary_key_idx
-                                          0);                  // write_op_key_idx
+    da = make_shared<dependency_analyzer>(init_outputs,    // init_output
+                                          real_outputs,    // total_output
+                                          real_tid_queue,  // final_tid_queue
+                                          real_stmt_usage, // final_stmt_usage
+                                          real_txn_status, // final_txn_status
+                                          trans_num);      // t_num
 
     cerr << "check transaction dependency ...      ";
     if (da->check_G1a() == true)
     {
         cerr << "check_G1a violate!!" << endl;
+        report.anomaly = ANOMALY_G1A;
         return true;
     }
     if (da->check_G1b() == true)
     {
         cerr << "check_G1b violate!!" << endl;
+        report.anomaly = ANOMALY_G1B;
         return true;
     }
     if (da->check_G1c() == true)
     {
         cerr << "check_G1c violate!!" << endl;
+        report.anomaly = ANOMALY_G1C;
         return true;
     }
     if (da->check_G2_item() == true)
     {
         cerr << "check_G2_item violate!!" << endl;
+        report.anomaly = ANOMALY_G2_ITEM;
         return true;
     }
     // if (da->check_GSIa() == true)
@@ -267,6 +257,7 @@ bool transaction_test::analyze_txn_dependency(shared_ptr<dependency_analyzer> &d
     if (da->check_any_transaction_cycle(true) == true)
     {
         cerr << "check_any_cycle violate!!" << endl;
+        report.anomaly = ANOMALY_CYCLE;
         return true;
     }
 
@@ -275,6 +266,7 @@ bool transaction_test::analyze_txn_dependency(shared_ptr<dependency_analyzer> &d
 
 void transaction_test::clear_execution_status()
 {
+    executor.clear();
     for (int tid = 0; tid < trans_num; tid++)
     {
         trans_arr[tid].stmt_err_info.clear();
@@ -287,18 +279,51 @@ void transaction_test::clear_execution_status()
         trans_arr[tid].normal_outputs.clear();
         trans_arr[tid].normal_err_info.clear();
     }
-    init_db_content.clear();
+    if (!test_dbms_info.content_fingerprint)
+        init_outputs.reset();
 
     real_tid_queue.clear();
     real_stmt_queue.clear();
-    real_output_queue.clear();
+    // a new one, as an analyzer of the previous run may still use the old
+    real_outputs = make_shared<recorded_outputs>(OUTPUT_PRIMARY_KEY_IDX, OUTPUT_WRITE_OP_KEY_IDX);
     real_stmt_usage.clear();
     trans_db_content.clear();
+    trans_db_checksum.clear();
 
     // normal test related
     normal_stmt_output.clear();
     normal_stmt_err_info.clear();
     normal_stmt_db_content.clear();
+    normal_stmt_db_checksum.clear();
+}
+
+void transaction_test::get_init_db_content()
+{
+    // every run starts from the same backup, so with --content-fingerprint
+    // the rows fetched for an earlier run are still the ones in the database
+    map<string, string> checksum;
+    if (test_dbms_info.content_fingerprint)
+    {
+        dut_get_content_checksum(test_dbms_info, checksum);
+        if (checksum == init_db_checksum && init_outputs)
+            return;
+    }
+
+    map<string, vector<vector<string>>> content;
+    dut_get_content(test_dbms_info, content);
+    init_outputs = make_shared<recorded_outputs>(OUTPUT_PRIMARY_KEY_IDX, OUTPUT_WRITE_OP_KEY_IDX);
+    for (auto &table : content)
+        init_outputs->append(move(table.second));
+    init_db_checksum = checksum;
+}
+
+void transaction_test::get_db_content(map<string, vector<vector<string>>> &content,
+                                      map<string, string> &checksum)
+{
+    if (test_dbms_info.content_fingerprint)
+        dut_get_content_checksum(test_dbms_info, checksum);
+    if (!test_dbms_info.content_fingerprint || fetch_db_content)
+        dut_get_content(test_dbms_info, content);
 }
 
 // 2: fatal error (e.g. restart transaction, current transaction is aborted), skip the stmt
@@ -308,14 +333,19 @@ void transaction_test::clear_execution_status()
 int transaction_test::trans_test_unit(int stmt_pos, stmt_output &output, bool debug_mode)
 {
     auto tid = tid_queue[stmt_pos];
-    auto stmt = print_stmt_to_string(stmt_queue[stmt_pos]);
+    auto rendered = render_stmt(stmt_queue[stmt_pos]);
+    auto stmt = rendered->sql;
 
     auto show_str = stmt.substr(0, stmt.size() > SHOW_CHARACTERS ? SHOW_CHARACTERS : stmt.size());
     replace(show_str.begin(), show_str.end(), '\n', ' ');
 
+    // instrumentation reads repeat the same few statements over and over
+    auto prepared = test_dbms_info.prepared_instrumentation &&
+                    stmt_use[stmt_pos].is_instrumented &&
+                    rendered->kind == KIND_SELECT;
     try
     {
-        trans_arr[tid].dut->test(stmt, &output);
+        executor.test(tid, trans_arr[tid].dut, stmt, &output, NULL, prepared);
         trans_arr[tid].stmt_outputs.push_back(output);
         trans_arr[tid].stmt_err_info.push_back("");
         if (debug_mode)
@@ -345,11 +375,7 @@ int transaction_test::trans_test_unit(int stmt_pos, stmt_output &output, bool de
             exit(-1);
 
         // store the error info of non-commit statement
-        auto commit_str = trans_arr[tid].dut->commit_stmt();
-        auto is_commit = (stmt.find(commit_str) != string::npos) &&
-                         (stmt.size() <= commit_str.size() + 3) &&
-                         (stmt.size() >= commit_str.size());
-        if (!is_commit)
+        if (rendered->kind != KIND_COMMIT)
         { // it is not commit stmt
             stmt_output empty_output;
             output = empty_output;
@@ -369,7 +395,7 @@ int transaction_test::trans_test_unit(int stmt_pos, stmt_output &output, bool de
         show_str = stmt.substr(0, stmt.size() > SHOW_CHARACTERS ? SHOW_CHARACTERS : stmt.size());
         try
         {
-            trans_arr[tid].dut->test(stmt);
+            executor.test(tid, trans_arr[tid].dut, stmt);
             stmt_output empty_output;
             output = empty_output;
             trans_arr[tid].stmt_outputs.push_back(empty_output);
@@ -389,282 +415,228 @@ int transaction_test::trans_test_unit(int stmt_pos, stmt_output &output, bool de
     return 0;
 }
 
+// append the result of trans_test_unit() to the real_* queues
+void transaction_test::record_executed_stmt(int stmt_pos, int is_executed, stmt_output &&output)
+{
+    auto tid = tid_queue[stmt_pos];
+    auto su = stmt_use[stmt_pos];
+
+    real_tid_queue.push_back(tid);
+    real_outputs->append(move(output));
+    if (is_executed == 2)
+    { // skipped
+        real_stmt_queue.push_back(make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT));
+        real_stmt_usage.push_back(stmt_usage(
+            transform_to_deleted_stmt(su.stmt_type),
+            su.is_instrumented));
+    }
+    else
+    {
+        real_stmt_queue.push_back(stmt_queue[stmt_pos]);
+        real_stmt_usage.push_back(su);
+    }
+    executed_stmt_num++;
+}
+
 /**
- * If a transaction has committed / aborted, it makes sense to try again
- * to execute blocked statements, which might now be unblocked.
- * This function does that.
- *
- * @param cur_stmt_num Nr nr of the statement which might have unblocked stuff. So only look at < cur_stmt_num.
+ * Announces to the dut the statements that its transaction runs right after
+ * the head of its ready queue: the following ready statements, up to the
+ * next begin, commit or abort. run_ready_stmts() runs them back to back, so
+ * the dut can send them together with the head in one batch. Statements that
+ * are not ready yet are left out, as other transactions may run before them.
  */
-void transaction_test::retry_block_stmt(int cur_stmt_num, int *status_queue, bool debug_mode)
+void transaction_test::pipeline_txn_block(int tid)
 {
-    if (debug_mode)
-        cerr << YELLOW << "retrying process begin..." << RESET << endl;
+    auto &ready = txn_ready_queue[tid];
+    auto head = render_stmt(stmt_queue[ready.front()]);
+    if (head->kind == KIND_BEGIN || head->is_txn_end())
+        return;
 
-    // firstly try the first stmt of each blocked transaction
-    set<int> first_tried_tid;
-    for (int i = 0; i < cur_stmt_num; i++)
+    vector<string> next_stmts;
+    for (size_t i = 1; i < ready.size(); i++)
     {
-        if (status_queue[i] == 1)
-            continue;
-
-        auto tid = tid_queue[i];
-        auto su = stmt_use[i];
-        if (trans_arr[tid].is_blocked == false)
-            continue;
+        if (next_stmts.size() + 1 >= MAX_BATCH_STMTS)
+            break;
+        auto next = render_stmt(stmt_queue[ready[i]]);
+        if (next->kind == KIND_BEGIN || next->is_txn_end())
+            break;
+        next_stmts.push_back(next->sql);
+    }
+    if (!next_stmts.empty())
+        trans_arr[tid].dut->pipeline(head->sql, next_stmts);
+}
 
-        if (first_tried_tid.count(tid) != 0) // have tried
-            continue;
+/**
+ * Runs the ready statements of a transaction in order, until it is blocked
+ * or has nothing ready left.
+ * When it is blocked, its edges in the wait-for graph are taken from the
+ * sessions holding the locks it waits for.
+ *
+ * @return true if the transaction has committed or aborted.
+ */
+bool transaction_test::run_ready_stmts(int tid, bool debug_mode)
+{
+    auto &ready = txn_ready_queue[tid];
+    while (!ready.empty())
+    {
+        auto stmt_pos = ready.front();
+        if (test_dbms_info.batched_instrumentation && !executor.in_flight(tid))
+            pipeline_txn_block(tid);
 
-        first_tried_tid.insert(tid);
         stmt_output output;
-        auto is_executed = trans_test_unit(i, output, debug_mode);
-        if (is_executed == 1)
-        { // executed
-            trans_arr[tid].is_blocked = false;
-            status_queue[i] = 1;
-            real_tid_queue.push_back(tid);
-            real_stmt_queue.push_back(stmt_queue[i]);
-            real_output_queue.push_back(output);
-            real_stmt_usage.push_back(stmt_use[i]);
-        }
-        else if (is_executed == 2)
-        { // skipped
-            trans_arr[tid].is_blocked = false;
-
-            real_tid_queue.push_back(tid);
-            real_stmt_queue.push_back(make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT));
-            real_output_queue.push_back(output);
-            real_stmt_usage.push_back(stmt_usage(
-                transform_to_deleted_stmt(su.stmt_type),
-                su.is_instrumented));
-            status_queue[i] = 1;
-        }
-        else
+        auto is_executed = trans_test_unit(stmt_pos, output, debug_mode);
+        if (is_executed == 0)
         { // blocked
             trans_arr[tid].is_blocked = true;
+            txn_waits_for[tid].clear();
+            for (auto session : executor.lock_holders(tid))
+            {
+                if (session_to_tid.count(session) > 0)
+                    txn_waits_for[tid].insert(session_to_tid[session]);
+            }
+            return false;
         }
+
+        trans_arr[tid].is_blocked = false;
+        txn_waits_for[tid].clear();
+        ready.pop_front();
+        record_executed_stmt(stmt_pos, is_executed, move(output));
+
+        if (is_executed == 1 && render_stmt(stmt_queue[stmt_pos])->is_txn_end())
+            return true;
     }
+    return false;
+}
 
-    for (int stmt_pos = 0; stmt_pos < cur_stmt_num; stmt_pos++)
-    {
-        auto tid = tid_queue[stmt_pos];
-        auto su = stmt_use[stmt_pos];
-        // skip the tried but still blocked transaction
-        if (trans_arr[tid].is_blocked)
-            continue;
+/**
+ * Wakes and runs the blocked transactions that can make progress:
+ * those whose blocked statement finished in the background, those whose
+ * lock holders have all finished, and, after any transaction finishes,
+ * those whose lock holders are unknown.
+ * Woken transactions run in the order of their next statement, and the ones
+ * that finish wake their own waiters in turn.
+ *
+ * @param finished_tid transaction that just committed or aborted, -1 if none
+ */
+void transaction_test::run_woken_txns(int finished_tid, bool debug_mode)
+{
+    deque<int> finished;
+    if (finished_tid >= 0)
+        finished.push_back(finished_tid);
 
-        // skip the executed stmt
-        if (status_queue[stmt_pos] == 1)
-            continue;
+    while (true)
+    {
+        int done = -1;
+        if (!finished.empty())
+        {
+            done = finished.front();
+            finished.pop_front();
+        }
 
-        string stmt_str = print_stmt_to_string(stmt_queue[stmt_pos]);
-        stmt_output output;
-        auto is_executed = trans_test_unit(stmt_pos, output, debug_mode);
-        // successfully execute the stmt, so label as not blocked
-        if (is_executed == 1)
+        // (next stmt position, tid)
+        set<pair<int, int>> woken;
+        for (auto tid : executor.finished_slots())
         {
-            trans_arr[tid].is_blocked = false;
-            status_queue[stmt_pos] = 1;
-            real_tid_queue.push_back(tid);
-            real_stmt_queue.push_back(stmt_queue[stmt_pos]);
-            real_output_queue.push_back(output);
-            real_stmt_usage.push_back(stmt_use[stmt_pos]);
-
-            auto stmt = print_stmt_to_string(stmt_queue[stmt_pos]);
-            auto commit_str = trans_arr[tid].dut->commit_stmt();
-            auto abort_str = trans_arr[tid].dut->abort_stmt();
-            auto is_commit = (stmt.find(commit_str) != string::npos) &&
-                             (stmt.size() <= commit_str.size() + 3) &&
-                             (stmt.size() >= commit_str.size());
-            auto is_abort = (stmt.find(abort_str) != string::npos) &&
-                            (stmt.size() <= abort_str.size() + 3) &&
-                            (stmt.size() >= abort_str.size());
-            if (is_commit || is_abort)
+            if (trans_arr[tid].is_blocked && !txn_ready_queue[tid].empty())
+                woken.insert(make_pair(txn_ready_queue[tid].front(), tid));
+        }
+        for (int tid = 0; done >= 0 && tid < trans_num; tid++)
+        {
+            if (!trans_arr[tid].is_blocked || txn_ready_queue[tid].empty())
+                continue;
+
+            auto &waits_for = txn_waits_for[tid];
+            if (!waits_for.empty())
             {
-                // Recursively try to unblock other statements.
-                retry_block_stmt(stmt_pos, status_queue, debug_mode);
+                waits_for.erase(done);
+                if (!waits_for.empty())
+                    continue;
             }
+            woken.insert(make_pair(txn_ready_queue[tid].front(), tid));
         }
-        else if (is_executed == 2)
-        { // skipped
-            trans_arr[tid].is_blocked = false;
-            status_queue[stmt_pos] = 1;
-
-            real_tid_queue.push_back(tid);
-            real_stmt_queue.push_back(make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT));
-            real_output_queue.push_back(output);
-            real_stmt_usage.push_back(stmt_usage(
-                transform_to_deleted_stmt(su.stmt_type),
-                su.is_instrumented));
+
+        if (woken.empty())
+        {
+            if (finished.empty())
+                break;
+            continue;
         }
-        else
-        { // still blocked
-            trans_arr[tid].is_blocked = true;
+
+        if (debug_mode)
+            cerr << YELLOW << "waking " << woken.size() << " transactions" << RESET << endl;
+        for (auto &[stmt_pos, tid] : woken)
+        {
+            if (trans_arr[tid].is_blocked && run_ready_stmts(tid, debug_mode))
+                finished.push_back(tid);
         }
     }
-    if (debug_mode)
-        cerr << YELLOW << "retrying process end..." << RESET << endl;
 }
 
 /**
  * Runs the transactions, and records the real execution order of the statements
- * in `real_tid_queue`, `real_stmt_queue`, `real_output_queue`, and `real_stmt_usage`.
+ * in `real_tid_queue`, `real_stmt_queue`, `real_outputs`, and `real_stmt_usage`.
  */
 bool transaction_test::trans_test(bool debug_mode)
 {
     dut_reset_to_backup(test_dbms_info);
-    dut_get_content(test_dbms_info, init_db_content); // get initial database content
+    get_init_db_content(); // get initial database content
 
     if (debug_mode)
         cerr << YELLOW << "transaction test" << RESET << endl;
-    // status_queue: 0 -> blocked, 1->executed (succeed or fail)
-    int status_queue[stmt_num];
-
-    for (int i = 0; i < stmt_num; i++)
-        status_queue[i] = 0;
 
     /*
     Note: for sqlite, after using dut_reset_to_backup(),
     original connection is broken and the database only
     can be read. We need to reconnect to the new one.
     */
+    executor.clear();
+    session_to_tid.clear();
     for (int i = 0; i < trans_num; i++)
+    {
         trans_arr[i].dut = dut_setup(test_dbms_info);
+        auto session = trans_arr[i].dut->session_id();
+        if (session != 0)
+            session_to_tid[session] = i;
+    }
+
+    txn_ready_queue.assign(trans_num, deque<int>());
+    txn_waits_for.assign(trans_num, set<int>());
+    executed_stmt_num = 0;
 
+    // a statement becomes ready when its turn in tid_queue comes, and runs
+    // at once unless an earlier statement of its transaction is blocked.
+    // With --batched-instrumentation, a run of consecutive statements of one
+    // transaction becomes ready at once, so that it can be sent as a batch:
+    // no other transaction has a statement in between.
     for (int stmt_index = 0; stmt_index < stmt_num; stmt_index++)
     {
         auto tid = tid_queue[stmt_index];
-        auto &stmt = stmt_queue[stmt_index];
-        auto su = stmt_use[stmt_index];
-
+        txn_ready_queue[tid].push_back(stmt_index);
+        while (test_dbms_info.batched_instrumentation &&
+               stmt_index + 1 < stmt_num && tid_queue[stmt_index + 1] == tid)
+            txn_ready_queue[tid].push_back(++stmt_index);
         if (trans_arr[tid].is_blocked)
             continue;
 
-        stmt_output output;
-        auto is_executed = trans_test_unit(stmt_index, output, debug_mode);
-        if (is_executed == 0)
-        {
-            trans_arr[tid].is_blocked = true;
-            continue;
-        }
-        if (is_executed == 2)
-        { // the executed stmt fail
-            status_queue[stmt_index] = 1;
-            real_tid_queue.push_back(tid);
-            real_stmt_queue.push_back(make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT));
-            real_output_queue.push_back(output);
-            real_stmt_usage.push_back(stmt_usage(
-                transform_to_deleted_stmt(su.stmt_type),
-                su.is_instrumented));
-            continue;
-        }
-        status_queue[stmt_index] = 1;
-        real_tid_queue.push_back(tid);
-        real_stmt_queue.push_back(stmt);
-        real_output_queue.push_back(output);
-        real_stmt_usage.push_back(su);
-
-        // after a commit or abort, retry the statement
-        auto stmt_str = print_stmt_to_string(stmt);
-        auto commit_str = trans_arr[tid].dut->commit_stmt();
-        auto abort_str = trans_arr[tid].dut->abort_stmt();
-        auto is_commit = (stmt_str.find(commit_str) != string::npos) &&
-                         (stmt_str.size() <= commit_str.size() + 3) &&
-                         (stmt_str.size() >= commit_str.size());
-        auto is_abort = (stmt_str.find(abort_str) != string::npos) &&
-                        (stmt_str.size() <= abort_str.size() + 3) &&
-                        (stmt_str.size() >= abort_str.size());
-        if (is_commit || is_abort)
-        {
-            retry_block_stmt(stmt_index, status_queue, debug_mode);
-        }
+        auto finished = run_ready_stmts(tid, debug_mode);
+        run_woken_txns(finished ? tid : -1, debug_mode);
     }
 
-    int no_change = 0;
-    int executed = 0;
-    for (int i = 0; i < stmt_num; i++)
-    {
-        if (status_queue[i] == 1)
-            executed++;
-    }
-    if (executed < stmt_num)
-    {
-        cerr << RED << "UNABLE TO SCHEDULE ALL STATEMENTS" << RESET << "  ";
-        // cerr << RED << "some stmt is still not executed, finish them" << RESET << endl;
-        return false;
-    }
-    // Try to execute the blocked statements.
-    // Stop if we executed all statements, or if we didn't execute any new statements.
-    while (executed < stmt_num)
+    // the last statements may still wait for locks that are released in the
+    // background (e.g. a deadlock victim being rolled back), so keep polling
+    // them for a while before giving up
+    auto drain_begin = get_cur_time_ms();
+    while (executed_stmt_num < stmt_num && get_cur_time_ms() - drain_begin < TRANS_DRAIN_TIMEOUT_MS)
     {
-        retry_block_stmt(stmt_num, status_queue, debug_mode);
-        int new_executed = 0;
-        for (int i = 0; i < stmt_num; i++)
-        {
-            if (status_queue[i] == 1)
-                new_executed++;
-        }
-        if (new_executed == stmt_num)
+        if (!executor.wait(EXECUTOR_BLOCK_CHECK_MS))
             break;
-        if (executed == new_executed)
-        {
-            no_change++;
-            if (no_change > 2)
-            {
-                break;
-                // throw runtime_error("Transaction deadlock found");
-                // cerr << RED << "dead lock, they wait for each other, try to delete some stmt" << RESET << endl;
-                // no_change = 0;
-                // // get unexecuted stmt num of each txn
-                // int unexecuted_stmt_txn[trans_num];
-                // int last_stmt_idx_txn[trans_num];
-                // for (int i = 0; i < trans_num; i++)
-                //     unexecuted_stmt_txn[i] = 0;
-                // for (int i = 0; i < stmt_num; i++) {
-                //     if (status_queue[i] != 1)
-                //         unexecuted_stmt_txn[tid_queue[i]]++;
-                //     last_stmt_idx_txn[tid_queue[i]] = i;
-                // }
-                // // get the txn that has least unexecuted stmts
-                // int least_stmt_txn = 0;
-                // int least_stmt = -1;
-                // for (int i = 0; i < trans_num; i++) {
-                //     // some txn has executed all stmts, we only focus on that not executed all
-                //     if (unexecuted_stmt_txn[i] <= 1) // if only commit (or abort) stmt not executed, do not target on them
-                //         continue;
-                //     if (least_stmt == -1 || unexecuted_stmt_txn[i] < least_stmt) {
-                //         least_stmt = unexecuted_stmt_txn[i];
-                //         least_stmt_txn = i;
-                //     }
-                // }
-                // // replace the unexecuted stmt with SPACE_HOLDER_STMT
-                // cerr << RED << "target txn: " << least_stmt_txn << " stmt_num: " << least_stmt << RESET << endl;
-                // int replace_num = 0;
-                // for (int i = 0; i < stmt_num; i++) {
-                //     if (tid_queue[i] != least_stmt_txn)
-                //         continue;
-                //     if (status_queue[i] == 1) // do not change the executed stmt
-                //         continue;
-                //     if (last_stmt_idx_txn[least_stmt_txn] == i) // do not change commit or abort
-                //         continue;
-                //     stmt_queue[i] = make_shared<txn_string_stmt>((prod *)0, SPACE_HOLDER_STMT);
-                //     stmt_use[i].stmt_type = INIT_TYPE;
-                //     replace_num++;
-                // }
-                // cerr << "replace " << replace_num << " stmts" << endl;
-            }
-        }
-        executed = new_executed;
+        run_woken_txns(-1, debug_mode);
     }
 
-    for (int i = 0; i < stmt_num; i++)
+    if (executed_stmt_num < stmt_num)
     {
-        if (status_queue[i] == 1)
-            continue;
-
-        cerr << RED << "something error, some stmt is still not executed" << RESET << endl;
-        throw runtime_error("some stmt is still not executed");
+        cerr << RED << "UNABLE TO SCHEDULE ALL STATEMENTS" << RESET << "  ";
+        return false;
     }
 
     if (real_stmt_queue.size() != stmt_num)
@@ -676,7 +648,8 @@ bool transaction_test::trans_test(bool debug_mode)
     }
 
     // collect database information
-    dut_get_content(test_dbms_info, trans_db_content);
+    if (check_db_content)
+        get_db_content(trans_db_content, trans_db_checksum);
     return true;
 }
 
@@ -723,17 +696,59 @@ void transaction_test::save_test_case(string dir_name,
     cerr << RED << "done" << RESET << endl;
 }
 
-int transaction_test::record_bug_num = 0;
-pid_t transaction_test::server_process_id = 0xabcde;
+string test_outcome_to_string(test_outcome outcome)
+{
+    switch (outcome)
+    {
+    case TEST_NO_REPORT:
+        return "no_report";
+    case TEST_PASSED:
+        return "passed";
+    case TEST_SKIPPED:
+        return "skipped";
+    case TEST_NORMAL_BUG:
+        return "normal_bug";
+    case TEST_TRANS_BUG:
+        return "trans_bug";
+    case TEST_ERROR:
+        return "error";
+    }
+    return "unknown";
+}
 
-static unsigned long long get_cur_time_ms(void)
+string test_anomaly_to_string(test_anomaly anomaly)
 {
-    struct timeval tv;
-    struct timezone tz;
+    switch (anomaly)
+    {
+    case ANOMALY_NONE:
+        return "none";
+    case ANOMALY_G1A:
+        return "G1a";
+    case ANOMALY_G1B:
+        return "G1b";
+    case ANOMALY_G1C:
+        return "G1c";
+    case ANOMALY_G2_ITEM:
+        return "G2-item";
+    case ANOMALY_CYCLE:
+        return "cycle";
+    }
+    return "unknown";
+}
 
-    gettimeofday(&tv, &tz);
+atomic<int> transaction_test::record_bug_num(0);
 
-    return (tv.tv_sec * 1000ULL) + tv.tv_usec / 1000;
+// the servers of the --servers instances are restarted independently
+static map<int, pid_t> server_process_ids;
+static mutex server_process_ids_mutex;
+
+pid_t &transaction_test::server_process_id(int server_id)
+{
+    lock_guard<mutex> lock(server_process_ids_mutex);
+    auto iter = server_process_ids.find(server_id);
+    if (iter == server_process_ids.end()) // not forked yet, seen as dead
+        iter = server_process_ids.insert({server_id, 0xabcde}).first;
+    return iter->second;
 }
 
 void kill_process_with_SIGTERM(pid_t process_id)
@@ -754,16 +769,17 @@ void kill_process_with_SIGTERM(pid_t process_id)
 }
 
 // cannot be called by child process
-bool transaction_test::try_to_kill_server()
+bool transaction_test::try_to_kill_server(int server_id)
 {
+    auto &server_pid = server_process_id(server_id);
     cerr << "try killing the server..." << endl;
-    kill(server_process_id, SIGTERM);
+    kill(server_pid, SIGTERM);
     int ret;
     auto begin_time = get_cur_time_ms();
     bool flag = false;
     while (1)
     {
-        ret = kill(server_process_id, 0);
+        ret = kill(server_pid, 0);
         if (ret != 0)
         { // the process die
             flag = true;
@@ -771,7 +787,7 @@ bool transaction_test::try_to_kill_server()
         }
 
         int status;
-        auto res = waitpid(server_process_id, &status, WNOHANG);
+        auto res = waitpid(server_pid, &status, WNOHANG);
         if (res < 0)
         {
             if (errno == ECHILD)
@@ -786,7 +802,7 @@ bool transaction_test::try_to_kill_server()
                 throw runtime_error(string("waitpid() fail"));
             }
         }
-        if (res == server_process_id)
+        if (res == server_pid)
         { // the dead process is collected
             cerr << "waitpid succeed for the server process !!!" << endl;
             flag = true;
@@ -803,55 +819,229 @@ bool transaction_test::try_to_kill_server()
     return flag;
 }
 
+int transaction_test::standby_offset = 0;
+
+// instance in use by the fuzzing loops of each slot, see standby_offset
+static map<int, int> active_servers;
+static mutex active_servers_mutex;
+
+static int standby_partner(int server_id)
+{
+    auto offset = transaction_test::standby_offset;
+    return server_id < offset ? server_id + offset : server_id - offset;
+}
+
+// Readiness probe. A new connection is used, as a pooled one would not
+// notice that the server is gone, and the ping tells that it serves queries.
+static bool server_answers(dbms_info &d_info)
+{
+    try
+    {
+        auto dut = dut_connect(d_info);
+        dut->test("SELECT 1;");
+        return true;
+    }
+    catch (exception &e)
+    {
+        return false;
+    }
+}
+
+// Moves d_info to the instance server_id, with its backup.
+static void move_to_server(dbms_info &d_info, int server_id)
+{
+    dbms_info old_info;
+    old_info = d_info;
+    d_info.use_managed_server(server_id);
+    auto dir = managed_server_dir(d_info.dbms_name, server_id, d_info.server_profile);
+    if (save_backup_file(dir, old_info) == 0)
+        use_backup_file(dir + "/" + BACKUP_REPORT_FILE, d_info);
+}
+
+// Moves d_info to the instance its slot uses, true if it was elsewhere.
+static bool follow_active_server(dbms_info &d_info)
+{
+    if (transaction_test::standby_offset == 0 || d_info.server_id < 0)
+        return false;
+    int active_id;
+    {
+        lock_guard<mutex> lock(active_servers_mutex);
+        auto slot = d_info.server_id % transaction_test::standby_offset;
+        if (!active_servers.count(slot))
+            active_servers[slot] = slot;
+        active_id = active_servers[slot];
+    }
+    if (active_id == d_info.server_id)
+        return false;
+    move_to_server(d_info, active_id);
+    return true;
+}
+
+/**
+ * Replaces the server of d_info, which died or hangs: by the standby if it
+ * answers, and the old one is restarted as the standby, else by a new one.
+ */
+static void restart_server(dbms_info &d_info)
+{
+    while (transaction_test::try_to_kill_server(d_info.server_id) == false)
+    {
+    } // just for safe
+    dut_pool_invalidate();
+
+    if (transaction_test::standby_offset > 0 && d_info.server_id >= 0)
+    {
+        dbms_info standby_info;
+        standby_info = d_info;
+        standby_info.use_managed_server(standby_partner(d_info.server_id));
+        if (server_answers(standby_info))
+        {
+            cerr << "swap to the standby server " << standby_info.server_id << endl;
+            dbms_info old_info;
+            old_info = d_info;
+            {
+                lock_guard<mutex> lock(active_servers_mutex);
+                active_servers[d_info.server_id % transaction_test::standby_offset] = standby_info.server_id;
+            }
+            move_to_server(d_info, standby_info.server_id);
+            transaction_test::server_process_id(old_info.server_id) = fork_db_server(old_info);
+            return;
+        }
+    }
+    transaction_test::server_process_id(d_info.server_id) = fork_db_server(d_info);
+}
+
+void transaction_test::start_standby(dbms_info &d_info)
+{
+    dbms_info standby_info;
+    standby_info = d_info;
+    standby_info.use_managed_server(standby_partner(d_info.server_id));
+    if (!server_answers(standby_info))
+        server_process_id(standby_info.server_id) = fork_db_server(standby_info);
+}
+
+bool transaction_test::load_standby(dbms_info &d_info)
+{
+    if (standby_offset == 0 || d_info.server_id < 0)
+        return false;
+    dbms_info standby_info;
+    standby_info = d_info;
+    standby_info.use_managed_server(standby_partner(d_info.server_id));
+    if (!server_answers(standby_info))
+        return false; // still starting
+    try
+    {
+        standby_info = d_info;
+        move_to_server(standby_info, standby_partner(d_info.server_id));
+        dut_reset_to_backup(standby_info);
+        // the copy of the backup dropped the snapshot, save it in the standby
+        if (standby_info.snapshot_restore)
+            dut_backup(standby_info);
+        return true;
+    }
+    catch (exception &e)
+    {
+        cerr << "cannot load the standby: " << e.what() << endl;
+        return false;
+    }
+}
+
+/**
+ * Stops the managed instance of d_info with sig: SIGTERM shuts it down
+ * cleanly, SIGKILL is enough when its datadir is thrown away. The pid file
+ * names the mysqld, which is not the forked process under mysqld_safe.
+ */
+static void stop_managed_server(dbms_info &d_info, int sig)
+{
+    auto &server_pid = transaction_test::server_process_id(d_info.server_id);
+    auto pid_path = managed_server_dir(d_info.dbms_name, d_info.server_id, d_info.server_profile) + "/mysqld.pid";
+    pid_t mysqld_pid = 0;
+    ifstream pid_file(pid_path);
+    pid_file >> mysqld_pid;
+    if (mysqld_pid <= 0)
+        mysqld_pid = server_pid;
+
+    if (sig == SIGKILL && mysqld_pid != server_pid)
+        kill(server_pid, SIGKILL); // mysqld_safe would start it again
+    kill(mysqld_pid, sig);
+    auto begin_time = get_cur_time_ms();
+    while (waitpid(server_pid, NULL, WNOHANG) == 0 || kill(mysqld_pid, 0) == 0)
+    {
+        if (get_cur_time_ms() - begin_time > KILL_PROC_TIME_MS)
+        { // does not shut down
+            kill(server_pid, SIGKILL);
+            kill(mysqld_pid, SIGKILL);
+        }
+        usleep(SERVER_PROBE_INTERVAL_MS * 1000);
+    }
+    unlink(pid_path.c_str());
+    dut_pool_invalidate();
+}
+
+// Runs cmd on the datadir of the stopped instance of d_info, and restarts it.
+static void restart_on_datadir(dbms_info &d_info, const string &cmd)
+{
+    if (system(cmd.c_str()) != 0)
+        throw runtime_error("cannot run " + cmd);
+    transaction_test::server_process_id(d_info.server_id) = fork_db_server(d_info);
+    transaction_test::fork_if_server_closed(d_info);
+}
+
+// reflinks share the blocks until they are written, on file systems that
+// support them, and fall back to plain copies
+#define COPY_DATADIR "cp -a --reflink=auto "
+
+void transaction_test::save_datadir(dbms_info &d_info)
+{
+    auto dir = managed_server_dir(d_info.dbms_name, d_info.server_id, d_info.server_profile);
+    stop_managed_server(d_info, SIGTERM);
+    restart_on_datadir(d_info, "rm -rf " + dir + "/data_snapshot && " +
+                                   COPY_DATADIR + dir + "/data " + dir + "/data_snapshot");
+}
+
+void transaction_test::restore_datadir(dbms_info &d_info)
+{
+    auto dir = managed_server_dir(d_info.dbms_name, d_info.server_id, d_info.server_profile);
+    stop_managed_server(d_info, SIGKILL);
+    restart_on_datadir(d_info, "rm -rf " + dir + "/data && " +
+                                   COPY_DATADIR + dir + "/data_snapshot " + dir + "/data");
+}
+
 /**
  * If the server is no longer accessible, we:
  * 1. Kill the server process.
- * 2. Spawn a new server process.
+ * 2. Swap in the standby, or spawn a new server process.
+ * The server is ready once it answers a ping, it is probed meanwhile.
  */
 bool transaction_test::fork_if_server_closed(dbms_info &d_info)
 {
-    bool server_restart = false;
+    bool server_restart = follow_active_server(d_info);
     auto time_begin = get_cur_time_ms();
 
     while (1)
     {
-        try
-        {
-            auto dut = dut_setup(d_info);
-            if (server_restart)
-                sleep(3);
-            break; // connect successfully, so break;
+        if (server_answers(d_info))
+            break;
+
+        auto ret = kill(server_process_id(d_info.server_id), 0);
+        if (ret != 0)
+        { // server has die
+            cerr << "testing server die, restart it" << endl;
+            restart_server(d_info);
+            time_begin = get_cur_time_ms();
+            server_restart = true;
+            continue;
         }
-        catch (exception &e)
-        { // connect fail
-            auto ret = kill(server_process_id, 0);
-            if (ret != 0)
-            { // server has die
-                cerr << "testing server die, restart it" << endl;
-
-                while (try_to_kill_server() == false)
-                {
-                } // just for safe
-                server_process_id = fork_db_server(d_info);
-                time_begin = get_cur_time_ms();
-                server_restart = true;
-                continue;
-            }
 
-            auto time_end = get_cur_time_ms();
-            if (time_end - time_begin > WAIT_FOR_PROC_TIME_MS)
-            {
-                cerr << "testing server hang, kill it and restart" << endl;
-
-                while (try_to_kill_server() == false)
-                {
-                }
-                server_process_id = fork_db_server(d_info);
-                time_begin = get_cur_time_ms();
-                server_restart = true;
-                continue;
-            }
+        auto time_end = get_cur_time_ms();
+        if (time_end - time_begin > WAIT_FOR_PROC_TIME_MS)
+        {
+            cerr << "testing server hang, kill it and restart" << endl;
+            restart_server(d_info);
+            time_begin = get_cur_time_ms();
+            server_restart = true;
+            continue;
         }
+        usleep(SERVER_PROBE_INTERVAL_MS * 1000);
     }
 
     return server_restart;
@@ -986,7 +1176,7 @@ void transaction_test::normal_stmt_test(vector<stmt_id> &stmt_path)
             normal_stmt_err_info.push_back(err);
         }
     }
-    dut_get_content(test_dbms_info, normal_stmt_db_content);
+    get_db_content(normal_stmt_db_content, normal_stmt_db_checksum);
     cerr << "done" << endl;
 }
 
@@ -1006,8 +1196,23 @@ void print_stmt_output(stmt_output &output)
 
 bool transaction_test::check_normal_stmt_result(vector<stmt_id> &stmt_path, bool debug)
 {
+    if (!check_db_content)
+        throw runtime_error("BUG: check_normal_stmt_result() without the content of the transaction test");
+
     // check database content
-    if (!compare_content(trans_db_content, normal_stmt_db_content))
+    if (test_dbms_info.content_fingerprint)
+    {
+        if (!compare_content_checksum(trans_db_checksum, normal_stmt_db_checksum))
+        {
+            cerr << "trans_db_content is not equal to normal_stmt_db_content" << endl;
+            // show the rows if this run fetched them, and have the next ones fetch them
+            if (!trans_db_content.empty() && !normal_stmt_db_content.empty())
+                compare_content(trans_db_content, normal_stmt_db_content);
+            fetch_db_content = true;
+            return false;
+        }
+    }
+    else if (!compare_content(trans_db_content, normal_stmt_db_content))
     {
         cerr << "trans_db_content is not equal to normal_stmt_db_content" << endl;
         return false;
@@ -1344,15 +1549,15 @@ bool transaction_test::remove_separated_and_invalid_blocks()
  */
 bool transaction_test::multi_stmt_round_test()
 {
+    report.outcome = TEST_SKIPPED;
+    auto phase_begin = get_cur_time_ms();
     if (!block_scheduling())
         return false; // it will make many stmts fails, we replace these failed stmts with space holder
+    report.schedule_ms = get_cur_time_ms() - phase_begin;
     // delete replaced stmts
     for (int i = 0; i < stmt_queue.size(); i++)
     {
-        auto stmt_str = print_stmt_to_string(stmt_queue[i]);
-        if (stmt_str.find(SPACE_HOLDER_STMT) == string::npos)
-            continue;
-        if (stmt_str.length() > string(SPACE_HOLDER_STMT).length() + 3)
+        if (render_stmt(stmt_queue[i])->kind != KIND_SPACE_HOLDER)
             continue;
         // it is a space holder
         stmt_queue.erase(stmt_queue.begin() + i);
@@ -1360,14 +1565,19 @@ bool transaction_test::multi_stmt_round_test()
         stmt_use.erase(stmt_use.begin() + i);
         i--;
     }
+    phase_begin = get_cur_time_ms();
     instrument_txn_stmts();
+    report.instrument_ms = get_cur_time_ms() - phase_begin;
     original_stmt_queue = stmt_queue;
     original_stmt_use = stmt_use;
     original_tid_queue = tid_queue;
+    report.instrumented_stmt_num = stmt_queue.size();
 
     cerr << "Running test with instrumentation ... ";
+    phase_begin = get_cur_time_ms();
     if (!trans_test(false))
         return false; // first run, get all dependency information
+    report.executed_stmt_num = real_stmt_queue.size();
     cerr << "done" << endl;
 
     while (true)
@@ -1394,6 +1604,7 @@ bool transaction_test::multi_stmt_round_test()
             continue;
         break;
     }
+    report.run_ms = get_cur_time_ms() - phase_begin;
 
     // Sanity checks.
     // for (int i = 0; i < stmt_queue.size(); i++)
@@ -1425,10 +1636,14 @@ bool transaction_test::multi_stmt_round_test()
     //     stmts_as_str.push_back(print_stmt_to_string(i));
 
     shared_ptr<dependency_analyzer> init_da;
-    if (analyze_txn_dependency(init_da))
+    phase_begin = get_cur_time_ms();
+    auto found_anomaly = analyze_txn_dependency(init_da);
+    report.analyze_ms = get_cur_time_ms() - phase_begin;
+    if (found_anomaly)
         throw runtime_error("BUG: found in analyze_txn_dependency()");
 
     // We only care about the dependencies.
+    report.outcome = TEST_PASSED;
     return false;
 
     // // record init status
@@ -1624,14 +1839,20 @@ int transaction_test::test()
 {
     cerr << "\n\n";
     cerr << "transaction testing ... " << endl;
+    auto gen_begin = get_cur_time_ms();
     try
     {
         assign_txn_id();
         assign_txn_status();
         gen_txn_stmts();
+        report.gen_ms = get_cur_time_ms() - gen_begin;
+        report.txn_num = trans_num;
+        report.stmt_num = stmt_num;
     }
     catch (exception &e)
     {
+        report.outcome = TEST_NORMAL_BUG;
+        report.gen_ms = get_cur_time_ms() - gen_begin;
         cerr << RED << "Trigger a normal bugs when inializing the stmts" << RESET << endl;
         cerr << "Bug info: " << e.what() << endl;
         cerr << "Found normal bug " << record_bug_num << "!!!" << endl;
@@ -1641,7 +1862,7 @@ int transaction_test::test()
         if (make_dir_error_exit(dir_name) == 1)
             return 255;
 
-        string cmd = "mv " + string(NORMAL_BUG_FILE) + " " + dir_name;
+        string cmd = "mv " + normal_bug_file(test_dbms_info) + " " + dir_name + NORMAL_BUG_FILE;
         if (system(cmd.c_str()) == -1)
         {
             cerr << "system() error, return -1 in transaction_test::test!" << endl;
@@ -1649,6 +1870,7 @@ int transaction_test::test()
         }
 
         save_backup_file(dir_name, test_dbms_info); // save database
+        save_server_profile(dir_name, test_dbms_info);
         return 1;                                   // not need to do other transaction thing
     }
 
@@ -1661,12 +1883,14 @@ int transaction_test::test()
     {
         string err = e.what();
         cerr << "error captured by test: " << err << endl;
+        report.outcome = TEST_SKIPPED;
         if (err.find("INSTRUMENT_ERR") != string::npos) // it is cause by: after instrumented, the scheduling change and error in txn_test happens
             return 0;
         if (err.find("still not executed") != string::npos) // cannot reproduce
             return 0;
     }
 
+    report.outcome = TEST_TRANS_BUG;
     cerr << "Found transaction bug " << record_bug_num << "!!!" << endl;
     string dir_name = output_path_dir + "bug_" + to_string(record_bug_num) + "_trans/";
     record_bug_num++;
@@ -1674,6 +1898,7 @@ int transaction_test::test()
         return 255;
 
     save_backup_file(dir_name, test_dbms_info);
+    save_server_profile(dir_name, test_dbms_info);
     save_test_case(dir_name, "final", stmt_queue, tid_queue, stmt_use);
     // save_test_case(dir_name, "original", original_stmt_queue, original_tid_queue, original_stmt_use);
     return 1;
@@ -1681,15 +1906,19 @@ int transaction_test::test()
 
 transaction_test::transaction_test(dbms_info &d_info)
 {
-    trans_num = TXN_NUM; // 9
+    trans_num = d_info.txn_num;
     test_dbms_info = d_info;
+    fetch_db_content = false;
+    check_db_content = false;
+    real_outputs = make_shared<recorded_outputs>(OUTPUT_PRIMARY_KEY_IDX, OUTPUT_WRITE_OP_KEY_IDX);
+    report = test_report();
 
     trans_arr = new transaction[trans_num];
     commit_num = trans_num; // all commit
     stmt_num = 0;
     for (int i = 0; i < trans_num; i++)
     {
-        trans_arr[i].stmt_num = TXN_STMT_NUM;
+        trans_arr[i].stmt_num = d_info.txn_stmt_num;
         stmt_num += trans_arr[i].stmt_num;
     }
 
@@ -1699,6 +1928,12 @@ transaction_test::transaction_test(dbms_info &d_info)
     {
         make_dir_error_exit(output_path_dir);
     }
+    if (d_info.worker_id >= 0)
+    { // each worker has its own bug directory
+        output_path_dir += "worker_" + to_string(d_info.worker_id) + "/";
+        if (stat(output_path_dir.c_str(), &buffer) != 0)
+            make_dir_error_exit(output_path_dir);
+    }
 }
 
 transaction_test::~transaction_test()
@@ -7,14 +7,25 @@
 #include "general_process.hh"
 #include "instrumentor.hh"
 #include "dependency_analyzer.hh"
+#include "stmt_executor.hh"
 
 #include <sys/time.h>
 #include <sys/wait.h>
+#include <deque>
+#include <atomic>
+#include <mutex>
 
 using namespace std;
 
 #define SHOW_CHARACTERS 100
-#define SPACE_HOLDER_STMT "select 1 from (select 1) as subq_0 where 0 <> 0"
+// most statements sent in one batch with --batched-instrumentation
+#define MAX_BATCH_STMTS 64
+// how long blocked statements are waited for once every statement is ready
+#define TRANS_DRAIN_TIMEOUT_MS 10000
+// columns of the recorded output rows holding the primary key (pkey) and
+// the version (wkey)
+#define OUTPUT_PRIMARY_KEY_IDX 1
+#define OUTPUT_WRITE_OP_KEY_IDX 0
 
 struct transaction
 {
@@ -41,12 +52,79 @@ struct transaction
     txn_status status;
 };
 
+enum test_outcome
+{
+    TEST_NO_REPORT,  // the test process ended without a report
+    TEST_PASSED,     // the dependencies were checked, no anomaly
+    TEST_SKIPPED,    // the txns could not be scheduled or instrumented
+    TEST_NORMAL_BUG, // a statement triggered a bug while generating
+    TEST_TRANS_BUG,  // an anomaly or another transaction bug
+    TEST_ERROR       // the test stopped on an unexpected error
+};
+
+// the first check of analyze_txn_dependency() that failed
+enum test_anomaly
+{
+    ANOMALY_NONE,
+    ANOMALY_G1A,
+    ANOMALY_G1B,
+    ANOMALY_G1C,
+    ANOMALY_G2_ITEM,
+    ANOMALY_CYCLE
+};
+
+string test_outcome_to_string(test_outcome outcome);
+string test_anomaly_to_string(test_anomaly anomaly);
+
+/**
+ * What a test process tells its parent about one test. It is sent as is
+ * through a pipe, so it only holds plain fields.
+ */
+struct test_report
+{
+    int exit_code;
+    test_outcome outcome;
+    test_anomaly anomaly;
+    // next write_op_id of the test process
+    int write_op_id;
+
+    int txn_num;
+    int stmt_num;              // generated
+    int instrumented_stmt_num; // after the instrumentation
+    int executed_stmt_num;     // by the instrumented run
+
+    // time spent in each phase of the test
+    unsigned long long gen_ms;
+    unsigned long long schedule_ms;
+    unsigned long long instrument_ms;
+    unsigned long long run_ms; // the instrumented run, and its reruns without the invalid blocks
+    unsigned long long analyze_ms;
+};
+
 class transaction_test
 {
 public:
-    static int record_bug_num;
-    static pid_t server_process_id;
-    static bool try_to_kill_server();
+    // shared by the --workers threads
+    static atomic<int> record_bug_num;
+    // pid of the server forked for dbms_info::server_id
+    static pid_t &server_process_id(int server_id);
+    static bool try_to_kill_server(int server_id);
+
+    // With --standby, the managed instance s has a partner s + standby_offset
+    // that is kept running. When the instance in use dies or hangs, the
+    // fuzzing loops swap to its partner, and it is restarted as the standby.
+    // 0 without --standby.
+    static int standby_offset;
+    // forks the standby of the instance of d_info, without waiting for it
+    static void start_standby(dbms_info &d_info);
+    // loads the database of d_info into the standby, true if it answered
+    static bool load_standby(dbms_info &d_info);
+
+    // With --datadir-restore, save_datadir() copies the datadir of the
+    // managed instance of d_info aside with the server shut down, and
+    // restore_datadir() restarts the server on a fresh copy of it.
+    static void save_datadir(dbms_info &d_info);
+    static void restore_datadir(dbms_info &d_info);
 
     transaction *trans_arr;
     string output_path_dir;
@@ -59,6 +137,17 @@ public:
 
     shared_ptr<schema> db_schema;
 
+    // drives the in-flight statements of all transactions
+    stmt_executor executor;
+
+    // wait-for graph scheduler of trans_test()
+    // statements of each transaction whose turn has come but are not executed yet
+    vector<deque<int>> txn_ready_queue;
+    // transactions holding the locks a blocked transaction waits for, empty if unknown
+    vector<set<int>> txn_waits_for;
+    map<unsigned long, int> session_to_tid;
+    int executed_stmt_num;
+
     // TID of the transactions in the order in which we execute them.
     // e.g. { 1, 2, 0, 1 } -> stmt from 1, stmt from 2, stmt from 0, stmt from 1
     vector<int> tid_queue;
@@ -68,25 +157,40 @@ public:
     // The usage of the statements in the order in which we execute them.
     // same as `tid_queue` and `stmt_queue`.
     vector<stmt_usage> stmt_use;
-    // Initial database content, indexed by table name.
-    map<string, vector<vector<string>>> init_db_content;
+    // Initial database content, the rows of all tables.
+    shared_ptr<recorded_outputs> init_outputs;
+    // With --content-fingerprint, the checksums of the tables stand in for
+    // the contents, see dut_get_content_checksum(). init_outputs is kept
+    // across runs and only fetched again when init_db_checksum changes.
+    map<string, string> init_db_checksum;
+    // set once the checksums disagree, so that the reruns fetch the rows
+    bool fetch_db_content;
+    // whether trans_test() reads the content of the database when it is
+    // done. Only check_normal_stmt_result() uses it, so the callers that run
+    // that check set this, and the other runs skip the query.
+    bool check_db_content;
 
     vector<int> real_tid_queue;
     vector<shared_ptr<prod>> real_stmt_queue;
-    vector<stmt_output> real_output_queue;
+    shared_ptr<recorded_outputs> real_outputs;
     vector<stmt_usage> real_stmt_usage;
     map<string, vector<vector<string>>> trans_db_content;
+    map<string, string> trans_db_checksum;
 
     // normal stmt test related
     vector<stmt_output> normal_stmt_output;
     vector<string> normal_stmt_err_info;
     map<string, vector<vector<string>>> normal_stmt_db_content;
+    map<string, string> normal_stmt_db_checksum;
 
     // original stmt test case
     vector<int> original_tid_queue;
     vector<shared_ptr<prod>> original_stmt_queue;
     vector<stmt_usage> original_stmt_use;
 
+    // filled while test() runs
+    test_report report;
+
     /**
      * Populates the `tid_queue` with transaction IDs, which is the order
      * in which transaction statements should be executed.
@@ -126,9 +230,15 @@ public:
     // input da is empty; output the analyzed da
     bool analyze_txn_dependency(shared_ptr<dependency_analyzer> &da);
 
-    // reset trans_arr[tid] related data, clear real_*, clear normal_*, clear init_db_content.
+    // reset trans_arr[tid] related data, clear real_*, clear normal_*, clear init_outputs.
     void clear_execution_status();
 
+    // content of the database after a run, or only its checksum, see
+    // --content-fingerprint
+    void get_init_db_content();
+    void get_db_content(map<string, vector<vector<string>>> &content,
+                        map<string, string> &checksum);
+
     /**
      * Runs a test on the transaction.
      * The trasactions, transaction statements, and the database content are set before calling this function.
@@ -145,8 +255,11 @@ public:
      * Returns `true` if it was able to schedule all statements, `false` otherwise.
      */
     bool trans_test(bool debug_mode = true);
-    void retry_block_stmt(int cur_stmt_num, int *status_queue, bool debug_mode = true);
     int trans_test_unit(int stmt_pos, stmt_output &output, bool debug_mode = true);
+    bool run_ready_stmts(int tid, bool debug_mode = true);
+    void run_woken_txns(int finished_tid, bool debug_mode = true);
+    void record_executed_stmt(int stmt_pos, int is_executed, stmt_output &&output);
+    void pipeline_txn_block(int tid);
 
     static bool fork_if_server_closed(dbms_info &d_info);
 
@@ -13,6 +13,8 @@ using boost::smatch;
 #endif
 
 #include <thread>
+#include <mutex>
+#include <atomic>
 #include <typeinfo>
 
 #include "random.hh"
@@ -28,6 +30,8 @@ using boost::smatch;
 
 #include <sys/time.h>
 #include <sys/wait.h>
+#include <poll.h>
+#include <fcntl.h>
 
 using namespace std;
 
@@ -41,6 +45,7 @@ extern "C"
 }
 
 #include "transaction_test.hh"
+#include "self_test.hh"
 
 #define NORMAL_EXIT 0
 #define FIND_BUG_EXIT 7
@@ -50,68 +55,276 @@ extern "C"
 pthread_mutex_t mutex_timeout;
 pthread_cond_t cond_timeout;
 
-int child_pid = 0;
-bool child_timed_out = false;
+// how often a waiting worker checks its child
+#define WAIT_CHILD_POLL_MS 5
+// how often the stats of all workers are printed
+#define WORKER_REPORT_INTERVAL_S 60
+
+// number of fuzzing loops run as threads, see --workers
+static int worker_num = 1;
+// number of managed server instances the loops are spread over, see --servers
+static int server_num = 0;
+// run the tests of a database in one pre-forked process, see zygote
+static bool use_zygote = false;
+
+// Serializes the server checks and restarts of the fuzzing loops sharing a
+// server, and their forks. Each loop generates with the smith::gen_context of
+// its thread, so the generation itself runs in parallel, and the loops of the
+// other servers go on while one server restarts.
+static mutex &server_mutex(dbms_info &d_info)
+{
+    static mutex mutexes_mutex;
+    static map<int, mutex> mutexes;
+    lock_guard<mutex> lock(mutexes_mutex);
+    // an instance and its standby serve the same loops
+    return mutexes[d_info.server_id < 0 ? -1 : d_info.server_id % server_num];
+}
 
-extern int write_op_id;
+// true if the loop of d_info is the only one using its server
+static bool has_own_server(dbms_info &d_info)
+{
+    if (server_num == 0)
+        return worker_num == 1;
+    return d_info.server_id % server_num + server_num >= worker_num;
+}
 
-void kill_process_signal(int signal)
+static struct
+{
+    atomic<unsigned long> tests{0};
+    atomic<unsigned long> timeouts{0};
+    atomic<unsigned long> dbs{0};
+    atomic<unsigned long long> setup_ms{0}; // spent in generate_database()
+} worker_stats;
+
+/**
+ * Kills a test process that ran out of time. A server used by this worker
+ * only is also killed so that it is restarted; a shared one is only
+ * restarted by fork_if_server_closed() if it stopped answering.
+ */
+static void kill_timed_out_child(dbms_info &d_info, pid_t child_pid, int &status)
 {
-    if (signal != SIGALRM)
+    cerr << "child pid timeout, kill it" << endl;
+    kill(child_pid, SIGKILL);
+    waitpid(child_pid, &status, 0);
+    worker_stats.timeouts++;
+    if (has_own_server(d_info))
     {
-        printf("unexpect signal %d\n", signal);
-        exit(1);
+        while (transaction_test::try_to_kill_server(d_info.server_id) == false)
+        {
+        }
+    }
+}
+
+/**
+ * With --datadir-restore, a test process cannot restart the server, which is
+ * a child of its parent: it asks the parent through a pipe, and waits on a
+ * second one until the server is back.
+ */
+struct restore_channel
+{
+    int request[2] = {-1, -1}; // test process -> parent
+    int reply[2] = {-1, -1};   // parent -> test process
+
+    void open_pipes()
+    {
+        if (pipe(request) != 0)
+            throw runtime_error(string("pipe() fail"));
+        if (pipe(reply) != 0)
+        {
+            close(request[0]);
+            close(request[1]);
+            throw runtime_error(string("pipe() fail"));
+        }
+    }
+
+    // in the test process
+    void child_side()
+    {
+        if (request[0] < 0)
+            return;
+        close(request[0]);
+        close(reply[1]);
+        auto request_fd = request[1];
+        auto reply_fd = reply[0];
+        datadir_restore_hook = [request_fd, reply_fd](dbms_info &)
+        {
+            char c = 0;
+            if (write(request_fd, &c, 1) != 1 || read(reply_fd, &c, 1) != 1 || c != 0)
+                throw runtime_error(string("datadir restore fail"));
+        };
+    }
+
+    // in the parent, once the test process is forked
+    void parent_side()
+    {
+        if (request[0] < 0)
+            return;
+        close(request[1]);
+        close(reply[0]);
+        request[1] = reply[0] = -1;
+        fcntl(request[0], F_SETFL, O_NONBLOCK);
     }
 
-    if (child_pid > 0)
+    // in the parent: serves a pending request, and returns the time it took
+    steady_clock::duration serve(dbms_info &d_info)
     {
-        printf("child pid timeout, kill it\n");
-        child_timed_out = true;
-        kill(child_pid, SIGKILL);
-        // also kill server process to restart
-        while (transaction_test::try_to_kill_server() == false)
+        char c;
+        if (request[0] < 0 || read(request[0], &c, 1) != 1)
+            return steady_clock::duration::zero();
+        auto begin = steady_clock::now();
+        c = 0;
+        try
+        {
+            lock_guard<mutex> lock(server_mutex(d_info));
+            transaction_test::restore_datadir(d_info);
+        }
+        catch (exception &e)
+        {
+            cerr << "cannot restore the datadir: " << e.what() << endl;
+            c = 1;
+        }
+        if (write(reply[1], &c, 1) != 1)
+            cerr << "cannot answer the datadir restore" << endl;
+        return steady_clock::now() - begin;
+    }
+
+    void close_pipes()
+    {
+        for (auto fd : {request[0], request[1], reply[0], reply[1]})
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+        request[0] = request[1] = reply[0] = reply[1] = -1;
+    }
+};
+
+/**
+ * Waits for child_pid for at most timeout_s seconds, not counting the
+ * datadir restores it asks for. On timeout the child is killed, see
+ * kill_timed_out_child(), and true is returned.
+ */
+static bool wait_child(dbms_info &d_info, pid_t child_pid, int timeout_s, int &status,
+                       restore_channel *restore = NULL)
+{
+    auto deadline = steady_clock::now() + seconds(timeout_s);
+    while (1)
+    {
+        if (restore)
+            deadline += restore->serve(d_info);
+        auto res = waitpid(child_pid, &status, WNOHANG);
+        if (res == child_pid)
+            return false;
+        if (res < 0)
         {
+            cerr << "waitpid() fail: " << res << endl;
+            throw runtime_error(string("waitpid() fail"));
         }
+        if (steady_clock::now() >= deadline)
+            break;
+        this_thread::sleep_for(milliseconds(WAIT_CHILD_POLL_MS));
     }
 
-    cerr << "get SIGALRM, stop the process" << endl;
-    return;
+    kill_timed_out_child(d_info, child_pid, status);
+    return true;
+}
+
+/**
+ * A test process sends its test_report to the parent through a pipe. The
+ * report is smaller than PIPE_BUF, so it is written at once, and the parent
+ * reads it without blocking: other test processes may hold copies of the
+ * write end, so a child that died without a report does not close it.
+ */
+struct report_channel
+{
+    int fds[2];
+
+    report_channel()
+    {
+        if (pipe(fds) != 0)
+            throw runtime_error(string("pipe() fail"));
+    }
+
+    // in the test process
+    void send(const test_report &report)
+    {
+        close(fds[0]);
+        if (write(fds[1], &report, sizeof(report)) != sizeof(report))
+            cerr << "cannot send the test report" << endl;
+        close(fds[1]);
+    }
+
+    // in the parent, once the test process is forked
+    void parent_side()
+    {
+        close(fds[1]);
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    }
+
+    // in the parent, once the test process has ended
+    test_report receive()
+    {
+        test_report report = test_report();
+        if (read(fds[0], &report, sizeof(report)) != sizeof(report))
+            report.outcome = TEST_NO_REPORT;
+        close(fds[0]);
+        return report;
+    }
+};
+
+// test log of --test-log, one tab separated line per test
+static ofstream test_log;
+static mutex test_log_mutex;
+
+static void open_test_log(const string &path)
+{
+    test_log.open(path, ios::app);
+    if (!test_log)
+    {
+        cerr << "cannot open test log " << path << endl;
+        exit(1);
+    }
+    test_log << "time\tdb\tseed\toutcome\tanomaly\ttxns\tstmts\tinstrumented_stmts\texecuted_stmts\t"
+             << "gen_ms\tschedule_ms\tinstrument_ms\trun_ms\tanalyze_ms" << endl;
+}
+
+static void record_test_report(dbms_info &d_info, unsigned int rand_seed, const test_report &report)
+{
+    if (!test_log.is_open())
+        return;
+    lock_guard<mutex> lock(test_log_mutex);
+    test_log << time(NULL) << "\t" << d_info.test_db << "\t" << rand_seed << "\t"
+             << test_outcome_to_string(report.outcome) << "\t"
+             << test_anomaly_to_string(report.anomaly) << "\t"
+             << report.txn_num << "\t" << report.stmt_num << "\t"
+             << report.instrumented_stmt_num << "\t" << report.executed_stmt_num << "\t"
+             << report.gen_ms << "\t" << report.schedule_ms << "\t"
+             << report.instrument_ms << "\t" << report.run_ms << "\t" << report.analyze_ms << endl;
 }
 
 int fork_for_generating_database(dbms_info &d_info)
 {
-    static itimerval itimer;
+    unique_lock<mutex> lock(server_mutex(d_info));
     transaction_test::fork_if_server_closed(d_info);
 
-    write_op_id = 0;
-    child_pid = fork();
+    report_channel channel;
+    smith::ctx().write_op_id = 0;
+    auto child_pid = fork();
     if (child_pid == 0)
     { // in child process
         generate_database(d_info);
-        ofstream output_wkey("wkey.txt");
-        output_wkey << write_op_id << endl;
-        output_wkey.close();
+        test_report report = test_report();
+        report.outcome = TEST_PASSED; // TEST_NO_REPORT marks a missing report
+        report.exit_code = NORMAL_EXIT;
+        report.write_op_id = smith::ctx().write_op_id;
+        channel.send(report);
         exit(NORMAL_EXIT);
     }
-
-    itimer.it_value.tv_sec = TRANSACTION_TIMEOUT;
-    itimer.it_value.tv_usec = 0; // us limit
-    setitimer(ITIMER_REAL, &itimer, NULL);
+    lock.unlock();
+    channel.parent_side();
 
     int status;
-    auto res = waitpid(child_pid, &status, 0);
-    if (res <= 0)
-    {
-        cerr << "waitpid() fail: " << res << endl;
-        throw runtime_error(string("waitpid() fail"));
-    }
-
-    if (!WIFSTOPPED(status))
-        child_pid = 0;
-
-    itimer.it_value.tv_sec = 0;
-    itimer.it_value.tv_usec = 0;
-    setitimer(ITIMER_REAL, &itimer, NULL);
+    auto child_timed_out = wait_child(d_info, child_pid, TRANSACTION_TIMEOUT, status);
 
     if (WIFEXITED(status))
     {
@@ -150,83 +363,67 @@ int fork_for_generating_database(dbms_info &d_info)
         }
     }
 
-    ifstream input_wkey("wkey.txt");
-    input_wkey >> write_op_id;
-    input_wkey.close();
+    auto report = channel.receive();
+    if (report.outcome == TEST_NO_REPORT)
+        throw runtime_error(string("no report from generating database"));
 
-    write_op_id++;
+    smith::ctx().write_op_id = report.write_op_id + 1;
     // cerr << "updating write_op_id: "<< write_op_id << endl;
 
     return 0;
 }
 
 /**
- * Fork a child process to run the transaction test.
- * The child runs the test, and the parent waits for a specified timeout.
+ * Runs one transaction test in a test process. The exit code of the report
+ * is the one the test process ends with.
  */
-int fork_for_transaction_test(dbms_info &d_info)
+static test_report run_transaction_test(dbms_info &d_info)
 {
-    static itimerval itimer;
-
-    transaction_test::fork_if_server_closed(d_info);
-
-#ifndef DEBUG
-    child_pid = fork();
-#else
-    child_pid = 0;
-#endif
-    if (child_pid == 0)
-    { // in child process
-        try
+    test_report report = test_report();
+    report.exit_code = NORMAL_EXIT;
+    try
+    {
+        // cerr << "write_op_id: " << write_op_id << endl;
+        transaction_test tt(d_info);
+        auto ret = tt.test();
+        report = tt.report;
+        report.exit_code = NORMAL_EXIT;
+        dut_pool_report();
+        dut_restore_report();
+        schema_load_report();
+        if (ret == 1)
         {
-            // cerr << "write_op_id: " << write_op_id << endl;
-            transaction_test tt(d_info);
-            auto ret = tt.test();
-            if (ret == 1)
-            {
-                cerr << RED << "Find a bug !!!" << RESET << endl;
-                exit(FIND_BUG_EXIT);
-            }
-        }
-        catch (std::exception &e)
-        { // ignore runtime error
-            cerr << "in test: " << e.what() << endl;
+            cerr << RED << "Find a bug !!!" << RESET << endl;
+            report.exit_code = FIND_BUG_EXIT;
         }
-        exit(NORMAL_EXIT);
     }
+    catch (std::exception &e)
+    { // ignore runtime error
+        cerr << "in test: " << e.what() << endl;
+        report.outcome = TEST_ERROR;
+    }
+    report.write_op_id = smith::ctx().write_op_id;
+    return report;
+}
 
-    itimer.it_value.tv_sec = TRANSACTION_TIMEOUT;
-    itimer.it_value.tv_usec = 0; // us limit
-    setitimer(ITIMER_REAL, &itimer, NULL);
-
-    int status;
-    auto res = waitpid(child_pid, &status, 0);
-    if (res <= 0)
+static void check_test_exit_code(int exit_code)
+{
+    // cerr << "exit code: " << exit_code << endl;
+    if (exit_code == FIND_BUG_EXIT)
     {
-        cerr << "waitpid() fail: " << res << endl;
-        throw runtime_error(string("waitpid() fail"));
+        cerr << RED << "a bug is found in fork process" << RESET << endl;
+        transaction_test::record_bug_num++;
+        // abort();
     }
+    if (exit_code == 255)
+        abort();
+}
 
-    if (!WIFSTOPPED(status))
-        child_pid = 0;
-
-    itimer.it_value.tv_sec = 0;
-    itimer.it_value.tv_usec = 0;
-    setitimer(ITIMER_REAL, &itimer, NULL);
-
+// handles a test process that has ended, throws if it timed out
+static void check_test_status(int status, bool child_timed_out)
+{
     if (WIFEXITED(status))
-    {
-        auto exit_code = WEXITSTATUS(status); // only low 8 bit (max 255)
-        // cerr << "exit code: " << exit_code << endl;
-        if (exit_code == FIND_BUG_EXIT)
-        {
-            cerr << RED << "a bug is found in fork process" << RESET << endl;
-            transaction_test::record_bug_num++;
-            // abort();
-        }
-        if (exit_code == 255)
-            abort();
-    }
+        check_test_exit_code(WEXITSTATUS(status)); // only low 8 bit (max 255)
 
     if (WIFSIGNALED(status))
     {
@@ -245,10 +442,193 @@ int fork_for_transaction_test(dbms_info &d_info)
             // throw runtime_error(string("memory bug"));
         }
     }
+}
+
+/**
+ * Fork a child process to run the transaction test.
+ * The child runs the test, and the parent waits for a specified timeout.
+ */
+int fork_for_transaction_test(dbms_info &d_info, unsigned int rand_seed)
+{
+    unique_lock<mutex> lock(server_mutex(d_info));
+    transaction_test::fork_if_server_closed(d_info);
+
+    report_channel channel;
+    restore_channel restore;
+    if (d_info.datadir_restore)
+        restore.open_pipes();
+#ifndef DEBUG
+    auto child_pid = fork();
+#else
+    pid_t child_pid = 0;
+#endif
+    if (child_pid == 0)
+    { // in child process
+        lock.unlock();
+        restore.child_side();
+        auto report = run_transaction_test(d_info);
+        channel.send(report);
+        exit(report.exit_code);
+    }
+
+    lock.unlock();
+    channel.parent_side();
+    restore.parent_side();
 
+    int status;
+    auto child_timed_out = wait_child(d_info, child_pid, TRANSACTION_TIMEOUT, status, &restore);
+    restore.close_pipes();
+    worker_stats.tests++;
+    record_test_report(d_info, rand_seed, channel.receive());
+    check_test_status(status, child_timed_out);
     return 0;
 }
 
+/**
+ * With --zygote, the tests of a database run one after the other in a
+ * single pre-forked test process instead of a fresh fork each, so that the
+ * connections of its dut pool stay warm. It reads the seed of each test
+ * from seed_fd and answers with the test_report of the test. It is only
+ * recycled when it crashes or times out, or when the server restarts.
+ */
+struct zygote
+{
+    pid_t pid = 0;
+    int seed_fd = -1;   // parent -> zygote
+    int result_fd = -1; // zygote -> parent
+    restore_channel restore;
+};
+
+static void zygote_loop(dbms_info &d_info, int seed_fd, int result_fd)
+{
+    // every test starts from the generator state the zygote was forked
+    // with, as a freshly forked test process would
+    auto base_context = smith::ctx();
+
+    unsigned int rand_seed;
+    while (read(seed_fd, &rand_seed, sizeof(rand_seed)) == sizeof(rand_seed))
+    {
+        smith::ctx() = base_context;
+        smith::ctx().rng.seed(rand_seed);
+        auto report = run_transaction_test(d_info);
+        if (write(result_fd, &report, sizeof(report)) != sizeof(report))
+            break;
+    }
+    exit(NORMAL_EXIT);
+}
+
+// must be called with server_mutex(d_info) held, like any fork
+static void zygote_start(dbms_info &d_info, zygote &z)
+{
+    int seed_pipe[2], result_pipe[2];
+    if (pipe(seed_pipe) != 0)
+        throw runtime_error(string("pipe() fail"));
+    if (pipe(result_pipe) != 0)
+    {
+        close(seed_pipe[0]);
+        close(seed_pipe[1]);
+        throw runtime_error(string("pipe() fail"));
+    }
+
+    if (d_info.datadir_restore)
+        z.restore.open_pipes();
+    auto child_pid = fork();
+    if (child_pid < 0)
+        throw runtime_error(string("fork() fail"));
+    if (child_pid == 0)
+    { // in child process
+        close(seed_pipe[1]);
+        close(result_pipe[0]);
+        z.restore.child_side();
+        zygote_loop(d_info, seed_pipe[0], result_pipe[1]);
+    }
+
+    close(seed_pipe[0]);
+    close(result_pipe[1]);
+    z.restore.parent_side();
+    z.pid = child_pid;
+    z.seed_fd = seed_pipe[1];
+    z.result_fd = result_pipe[0];
+}
+
+// Other test processes may hold copies of the pipes, so the zygote is not
+// told to stop by closing them but killed.
+static void zygote_stop(zygote &z)
+{
+    if (z.pid > 0)
+    {
+        kill(z.pid, SIGKILL);
+        waitpid(z.pid, NULL, 0);
+    }
+    if (z.seed_fd >= 0)
+        close(z.seed_fd);
+    if (z.result_fd >= 0)
+        close(z.result_fd);
+    z.restore.close_pipes();
+    z = zygote();
+}
+
+int zygote_transaction_test(dbms_info &d_info, zygote &z, unsigned int rand_seed)
+{
+    unique_lock<mutex> lock(server_mutex(d_info));
+    if (transaction_test::fork_if_server_closed(d_info))
+        zygote_stop(z); // its connections are gone
+    if (z.pid == 0)
+        zygote_start(d_info, z);
+    lock.unlock();
+
+    worker_stats.tests++;
+    auto deadline = steady_clock::now() + seconds(TRANSACTION_TIMEOUT);
+    // a zygote that died is noticed by waitpid(), as its pipes may be kept
+    // open by other test processes
+    bool seed_sent = write(z.seed_fd, &rand_seed, sizeof(rand_seed)) == sizeof(rand_seed);
+    while (1)
+    {
+        struct pollfd pfd;
+        pfd.fd = z.result_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        test_report report;
+        if (seed_sent && poll(&pfd, 1, WAIT_CHILD_POLL_MS) > 0 &&
+            read(z.result_fd, &report, sizeof(report)) == sizeof(report))
+        {
+            record_test_report(d_info, rand_seed, report);
+            check_test_exit_code(report.exit_code);
+            return 0;
+        }
+
+        deadline += z.restore.serve(d_info);
+
+        int status;
+        auto res = waitpid(z.pid, &status, WNOHANG);
+        if (res == z.pid)
+        { // crashed or exited during the test
+            z.pid = 0;
+            zygote_stop(z);
+            record_test_report(d_info, rand_seed, test_report());
+            check_test_status(status, false);
+            return 0;
+        }
+        if (res < 0)
+        {
+            cerr << "waitpid() fail: " << res << endl;
+            throw runtime_error(string("waitpid() fail"));
+        }
+
+        if (steady_clock::now() >= deadline)
+        {
+            kill_timed_out_child(d_info, z.pid, status);
+            z.pid = 0;
+            zygote_stop(z);
+            record_test_report(d_info, rand_seed, test_report());
+            check_test_status(status, true);
+            return 0;
+        }
+        if (!seed_sent)
+            this_thread::sleep_for(milliseconds(WAIT_CHILD_POLL_MS));
+    }
+}
+
 int random_test(dbms_info &d_info)
 {
     random_device rd;
@@ -258,15 +638,19 @@ int random_test(dbms_info &d_info)
 #endif
     cerr << "\n\n";
     cerr << "random seed for db: " << rand_seed << endl;
-    smith::rng.seed(rand_seed);
+    smith::ctx().rng.seed(rand_seed);
+
+    // no datadir snapshot of the new database yet
+    datadir_restore_hook = NULL;
 
     // reset the target DBMS to initial state
     int setup_try_time = 0;
     while (1)
     {
+        unique_lock<mutex> lock(server_mutex(d_info));
         if (setup_try_time > MAX_SETUP_TRY_TIME)
         {
-            kill_process_with_SIGTERM(transaction_test::server_process_id);
+            kill_process_with_SIGTERM(transaction_test::server_process_id(d_info.server_id));
             setup_try_time = 0;
         }
 
@@ -274,7 +658,10 @@ int random_test(dbms_info &d_info)
         {
             // donot fork, so that the static schema can be used in each test case
             transaction_test::fork_if_server_closed(d_info);
+            lock.unlock();
+            auto setup_begin = steady_clock::now();
             generate_database(d_info);
+            worker_stats.setup_ms += duration_cast<milliseconds>(steady_clock::now() - setup_begin).count();
 
             // fork_for_generating_database(d_info);
             break;
@@ -285,8 +672,29 @@ int random_test(dbms_info &d_info)
             setup_try_time++;
         }
     }
+    if (d_info.datadir_restore)
+    {
+        lock_guard<mutex> lock(server_mutex(d_info));
+        transaction_test::save_datadir(d_info);
+        // the thread owns the server, so it restores it itself
+        datadir_restore_hook = [](dbms_info &info)
+        {
+            lock_guard<mutex> lock(server_mutex(info));
+            transaction_test::restore_datadir(info);
+        };
+    }
+    worker_stats.dbs++;
+    // if the server dies, the tests of the database go on on the standby
+    auto standby_loaded = transaction_test::load_standby(d_info);
+
+    zygote z;
+    if (use_zygote)
+    {
+        lock_guard<mutex> lock(server_mutex(d_info));
+        zygote_start(d_info, z);
+    }
 
-    int i = TEST_TIME_FOR_EACH_DB;
+    int i = d_info.tests_per_db;
     while (i--)
     {
         // each round, generate random seed again, otherwise it will perform the same tests
@@ -296,11 +704,14 @@ int random_test(dbms_info &d_info)
 #endif
         cerr << "\n\n";
         cerr << "random seed for tests: " << rand_seed << endl;
-        smith::rng.seed(rand_seed);
+        smith::ctx().rng.seed(rand_seed);
 
         try
         {
-            fork_for_transaction_test(d_info);
+            if (use_zygote)
+                zygote_transaction_test(d_info, z, rand_seed);
+            else
+                fork_for_transaction_test(d_info, rand_seed);
         }
         catch (exception &e)
         {
@@ -310,6 +721,11 @@ int random_test(dbms_info &d_info)
                 break;
             else if (err == "transaction test timeout")
             {
+                if (standby_loaded)
+                { // once, the standby of the standby is still starting
+                    standby_loaded = false;
+                    continue;
+                }
                 break; // break the test and begin a new test
                 // after killing and starting a new server, created tables might be lost
                 // so it needs to begin a new test to generate tables
@@ -317,11 +733,13 @@ int random_test(dbms_info &d_info)
             else
             {
                 cerr << "the exception cannot be handled" << endl;
+                zygote_stop(z);
                 throw e;
             }
         }
     }
 
+    zygote_stop(z);
     return 0;
 }
 
@@ -334,7 +752,8 @@ int main(int argc, char *argv[])
 tidb-db|tidb-port|\
 mysql-db|mysql-port|\
 mariadb-db|mariadb-port|\
-output-or-affect-num|\
+output-or-affect-num|prepared-instrumentation|batched-instrumentation|snapshot-restore|workers|servers|standby|datadir-restore|content-fingerprint|server-profile|zygote|test-log|\
+txns|concurrent-txns|txn-stmts|tests-per-db|history-benchmark|self-test|\
 reproduce-sql|reproduce-tid|reproduce-usage|reproduce-backup)(?:=((?:.|\n)*))?");
 
     for (char **opt = argv + 1; opt < argv + argc; opt++)
@@ -371,6 +790,23 @@ reproduce-sql|reproduce-tid|reproduce-usage|reproduce-backup)(?:=((?:.|\n)*))?")
              <<
 #endif
             "   --output-or-affect-num=int     generating statement that output num rows or affect num rows" << endl
+             << "   --prepared-instrumentation     run instrumentation reads as server-side prepared statements (mariadb and tidb)" << endl
+             << "   --batched-instrumentation      send each instrumentation block of a txn as one multi-statement batch" << endl
+             << "   --snapshot-restore             restore the database from a copy of its tables kept in the server" << endl
+             << "   --workers=int                  run int fuzzing loops in parallel, each on its own database <db>_<i>" << endl
+             << "   --servers=int                  start int mysql/mariadb instances on mysql-port..mysql-port+int-1 and spread the workers over them" << endl
+             << "   --standby                      with --servers, keep a started standby of each server to swap in when it dies" << endl
+             << "   --datadir-restore              with --servers, restore the database by restarting its server on a copy of its datadir" << endl
+             << "   --content-fingerprint          compare database contents by server-side checksums, fetch the rows only when needed" << endl
+             << "   --server-profile=default|fuzz  settings of the forked mysql/mariadb servers, fuzz: datadir on tmpfs and no durability" << endl
+             << "   --zygote                       run the tests of a database in one pre-forked process with warm connections" << endl
+             << "   --test-log=filename            append the outcome, statement counts and phase timings of each test" << endl
+             << "   --txns=int                     transactions per test (default: 2 * concurrent-txns)" << endl
+             << "   --concurrent-txns=int          transactions interleaved at a time (default: 3)" << endl
+             << "   --txn-stmts=int                statements per transaction, with the begin and commit/abort (default: 4)" << endl
+             << "   --tests-per-db=int             tests run on each generated database (default: 10)" << endl
+             << "   --history-benchmark            time the dependency analyzer history on synthetic histories and exit" << endl
+             << "   --self-test                    check the backup and content paths on <db>_self_test and exit" << endl
              << "   --reproduce-sql=filename       sql file to reproduce the problem" << endl
              << "   --reproduce-tid=filename       tid file to reproduce the problem" << endl
              << "   --reproduce-usage=filename     stmt usage file to reproduce the problem" << endl
@@ -383,6 +819,11 @@ reproduce-sql|reproduce-tid|reproduce-usage|reproduce-backup)(?:=((?:.|\n)*))?")
     {
         return 0;
     }
+    else if (options.count("history-benchmark"))
+    {
+        history_benchmark();
+        return 0;
+    }
 
     // set timeout action
     struct sigaction action;
@@ -396,18 +837,6 @@ reproduce-sql|reproduce-tid|reproduce-usage|reproduce-backup)(?:=((?:.|\n)*))?")
         exit(1);
     }
 
-    // set timeout action for fork
-    struct sigaction sa;
-    memset(&sa, 0, sizeof(sa));
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = SA_RESTART;
-    sa.sa_handler = kill_process_signal;
-    if (sigaction(SIGALRM, &sa, NULL))
-    {
-        cerr << "sigaction error" << endl;
-        exit(1);
-    }
-
     // init the lock
     pthread_mutex_init(&mutex_timeout, NULL);
     pthread_cond_init(&cond_timeout, NULL);
@@ -491,9 +920,103 @@ reproduce-sql|reproduce-tid|reproduce-usage|reproduce-backup)(?:=((?:.|\n)*))?")
         return 0;
     }
 
+    if (options.count("self-test"))
+    {
+        transaction_test::fork_if_server_closed(d_info);
+        return run_self_test(d_info) == 0 ? 0 : 1;
+    }
+
+    if (options.count("workers"))
+        worker_num = max(stoi(options["workers"]), 1);
+    if (options.count("servers"))
+    {
+        if (d_info.dbms_name != "mysql" && d_info.dbms_name != "mariadb")
+        {
+            cerr << "--servers only supports mysql and mariadb" << endl;
+            return 1;
+        }
+        server_num = max(stoi(options["servers"]), 1);
+        if (!options.count("workers"))
+            worker_num = server_num; // one loop per server
+        server_num = min(server_num, worker_num);
+        if (options.count("standby"))
+            transaction_test::standby_offset = server_num;
+    }
+    if (d_info.datadir_restore && (server_num < worker_num || transaction_test::standby_offset > 0))
+    {
+        // restarting a shared server would break the tests of the other workers
+        cerr << "--datadir-restore needs a server per worker, see --servers, and no --standby" << endl;
+        return 1;
+    }
+    use_zygote = options.count("zygote") > 0;
+#ifdef DEBUG
+    if (use_zygote)
+    {
+        // debug builds run the tests in the main process, without forking
+        cerr << "--zygote is not supported in DEBUG builds" << endl;
+        return 1;
+    }
+#endif
+    if (use_zygote)
+        signal(SIGPIPE, SIG_IGN); // a zygote may die before it reads its seed
+    if (options.count("test-log"))
+        open_test_log(options["test-log"]);
+    if (worker_num == 1)
+    {
+        if (server_num > 0)
+            d_info.use_managed_server(0);
+        if (transaction_test::standby_offset > 0)
+        {
+            transaction_test::fork_if_server_closed(d_info);
+            transaction_test::start_standby(d_info);
+        }
+        while (1)
+        {
+            random_test(d_info);
+        }
+    }
+
+    // the client library is initialized by the first connection, before
+    // the workers connect concurrently
+    if (server_num == 0)
+        transaction_test::fork_if_server_closed(d_info);
+    for (int s = 0; s < server_num; s++)
+    {
+        dbms_info server_info;
+        server_info = d_info;
+        server_info.use_managed_server(s);
+        transaction_test::fork_if_server_closed(server_info);
+        if (transaction_test::standby_offset > 0)
+            transaction_test::start_standby(server_info);
+    }
+
+    vector<thread> workers;
+    for (int i = 0; i < worker_num; i++)
+    {
+        workers.push_back(thread([&d_info, i]()
+                                 {
+                                     dbms_info worker_info;
+                                     worker_info = d_info;
+                                     worker_info.test_db = d_info.test_db + "_" + to_string(i);
+                                     worker_info.worker_id = i;
+                                     if (server_num > 0)
+                                         worker_info.use_managed_server(i % server_num);
+                                     while (1)
+                                     {
+                                         random_test(worker_info);
+                                     } }));
+    }
+
     while (1)
     {
-        random_test(d_info);
+        sleep(WORKER_REPORT_INTERVAL_S);
+        cerr << "workers: " << worker_num
+             << ", servers: " << max(server_num, 1)
+             << ", databases: " << worker_stats.dbs
+             << ", setup: " << worker_stats.setup_ms / max(worker_stats.dbs.load(), 1UL) << " ms avg"
+             << ", tests: " << worker_stats.tests
+             << ", timeouts: " << worker_stats.timeouts
+             << ", bugs: " << transaction_test::record_bug_num << endl;
     }
 
     return 0;